@@ -0,0 +1,367 @@
+// bench.cpp
+// Benchmark harness for stepping, loading, and rendering
+
+// required headers:
+#include "grid.h"
+#include "tui.h"
+#include "engine.h"
+#include "hashlife.h"
+#include "tiled.h"
+#include "plane.h"
+#include "pattern.h"
+#include "checkpoint.h"
+#include "strips.h"
+#include <chrono>
+#include <cstdio>
+#include <fcntl.h>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+
+// how long each benchmark repeats its work for, at least, in seconds
+double min_time = 0.5;
+
+// node count at which the hashlife engine garbage collects its cache
+const size_t hashlife_max_nodes = 1 << 22;
+
+// Result class that builds one benchmark result as a line of JSON, so that
+// results can be collected and compared by other programs
+class Result {
+    std::ostringstream line;
+
+    public:
+
+    // constructor that starts a result for the named benchmark group
+    Result(std::string const &group) {
+        line << "{\"group\":\"" << group << '"';
+    }
+
+    // field function that adds a text field
+    Result &field(std::string const &name, std::string const &value) {
+        line << ",\"" << name << "\":\"" << value << '"';
+        return *this;
+    }
+
+    // field function that adds a numeric field
+    Result &field(std::string const &name, double value) {
+        line << ",\"" << name << "\":" << value;
+        return *this;
+    }
+
+    // print function that writes the result to stdout
+    void print() {
+        std::cout << line.str() << "}\n" << std::flush;
+    }
+};
+
+// repeat function that calls work until at least min_time has passed,
+// returning the number of calls and setting seconds to the time they took
+uint64_t repeat(std::function<void()> const &work, double &seconds) {
+    uint64_t calls = 0;
+    auto start = std::chrono::steady_clock::now();
+    do {
+        work();
+        calls++;
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    } while (seconds < min_time);
+    return calls;
+}
+
+// random_grid function that returns a width x height grid in which each
+// tile is alive with the given probability, the same on every run
+Grid *random_grid(int width, int height, double density) {
+    std::mt19937 random(width * 31 + height);
+    std::bernoulli_distribution alive(density);
+    Grid *grid = new Grid(width, height);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            if (alive(random)) {
+                grid->set_tile(x, y, true);
+            }
+        }
+    }
+    return grid;
+}
+
+// generations per step of the grid engine when stepping in blocks
+const int time_block = 8;
+
+// make_engine function that hands a copy of the grid to the named engine
+Engine *make_engine(std::string const &name, Grid &grid) {
+    if (name == "grid") {
+        return new GridEngine(new Grid(grid));
+    } else if (name == "grid-blocked") {
+        return new GridEngine(new Grid(grid), 0, Topology::bounded, time_block);
+    } else if (name == "strips") {
+        return new StripEngine(grid, std::max(1u, std::thread::hardware_concurrency()));
+    } else if (name == "tiled") {
+        return new TiledEngine(grid);
+    } else if (name == "plane") {
+        return new PlaneEngine(grid);
+    }
+    return new HashLife(grid, 0, hashlife_max_nodes);
+}
+
+// bench_step function that times every engine stepping random boards of
+// several sizes and densities under several rules. soups settle down as
+// they run, so each run steps a fresh engine for a fixed number of
+// generations, and runs repeat until min_time has been spent stepping.
+// engines that take several generations per step may overshoot, so the
+// generations are counted by the engine
+void bench_step(std::vector<int> const &sizes, int generations) {
+    struct Rule { char const *name; int rule; };
+    const Rule rules[] = {
+        {"B3/S23", parse_rule("B3/S23")},               // specialized kernel
+        {"B36/S23", parse_rule("B36/S23")},             // specialized kernel
+        {"B35678/S5678", parse_rule("B35678/S5678")}    // generic kernel
+    };
+    const char *engines[] = {"grid", "grid-blocked", "tiled", "strips", "plane", "hashlife"};
+
+    for (int size : sizes) {
+        for (double density : {0.05, 0.35}) {
+            std::unique_ptr<Grid> grid(random_grid(size, size, density));
+            for (Rule const &rule : rules) {
+                for (char const *name : engines) {
+                    // hashlife caches every distinct node of a soup, which
+                    // big boards run out of memory doing
+                    if (std::string(name) == "hashlife" && size > 1024) {
+                        continue;
+                    }
+                    double seconds = 0;
+                    double total = 0;
+                    uint64_t runs = 0;
+                    while (seconds < min_time) {
+                        std::unique_ptr<Engine> engine(make_engine(name, *grid));
+                        auto start = std::chrono::steady_clock::now();
+                        while (engine->get_generation() < (uint64_t) generations) {
+                            engine->step(rule.rule);
+                            engine->commit();
+                        }
+                        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                        total += engine->get_generation();
+                        runs++;
+                    }
+                    Result("step")
+                        .field("engine", name)
+                        .field("size", size)
+                        .field("density", density)
+                        .field("rule", rule.name)
+                        .field("generations", total / runs)
+                        .field("runs", runs)
+                        .field("seconds", seconds)
+                        .field("generations_per_sec", total / seconds)
+                        .field("ns_per_cell", seconds * 1e9 / total / ((double) size * size))
+                        .print();
+                }
+            }
+        }
+    }
+}
+
+// bench_update_tile function that times the one-tile update used outside
+// the vector kernels
+void bench_update_tile(int size) {
+    std::unique_ptr<Grid> prev(random_grid(size, size, 0.35));
+    Grid next(size, size);
+    double seconds;
+    uint64_t passes = repeat([&] {
+        for (int y = 0; y < size; ++y) {
+            for (int x = 0; x < size; ++x) {
+                next.update_tile(*prev, x, y, 6152);
+            }
+        }
+    }, seconds);
+    Result("update_tile")
+        .field("size", size)
+        .field("passes", passes)
+        .field("seconds", seconds)
+        .field("ns_per_tile", seconds * 1e9 / passes / ((double) size * size))
+        .print();
+}
+
+// bench_load function that writes a random board as a text file, an RLE
+// file, and a checkpoint, then times loading each one
+void bench_load(int size) {
+    std::unique_ptr<Grid> grid(random_grid(size, size, 0.35));
+    std::string base = "/tmp/p3bench." + std::to_string(getpid());
+    std::string text_path = base + ".txt";
+    std::string rle_path = base + ".rle";
+    std::string checkpoint_path = base + ".ckpt";
+
+    // text: one line per row, '#' for live tiles
+    {
+        std::ofstream out(text_path);
+        std::string line;
+        for (int y = 0; y < size; ++y) {
+            line.clear();
+            for (int x = 0; x < size; ++x) {
+                line += grid->get_tile(x, y) ? '#' : ' ';
+            }
+            out << line << '\n';
+        }
+    }
+
+    // rle: runs of dead (b) and live (o) tiles, with rows ending in $
+    {
+        std::ofstream out(rle_path);
+        out << "x = " << size << ", y = " << size << ", rule = B3/S23\n";
+        for (int y = 0; y < size; ++y) {
+            int x = 0;
+            while (x < size) {
+                bool alive = grid->get_tile(x, y);
+                int run = 0;
+                while (x < size && grid->get_tile(x, y) == alive) {
+                    ++run;
+                    ++x;
+                }
+                if (run > 1) {
+                    out << run;
+                }
+                out << (alive ? 'o' : 'b');
+            }
+            out << (y + 1 < size ? "$\n" : "!\n");
+        }
+    }
+
+    write_checkpoint(checkpoint_path, *grid, 0, 6152);
+
+    struct Format { char const *name; std::string path; };
+    const Format formats[] = {
+        {"text", text_path},
+        {"rle", rle_path},
+        {"checkpoint", checkpoint_path},
+    };
+    for (Format const &format : formats) {
+        double bytes = std::ifstream(format.path, std::ios::ate | std::ios::binary).tellg();
+        double seconds;
+        uint64_t loads = repeat([&] {
+            int rule = 6152;
+            uint64_t generation = 0;
+            Grid *loaded = (std::string(format.name) == "checkpoint")
+                         ? read_checkpoint(format.path, generation, rule)
+                         : load_pattern(format.path, rule);
+            delete loaded;
+        }, seconds);
+        Result("load")
+            .field("format", format.name)
+            .field("size", size)
+            .field("bytes", bytes)
+            .field("loads", loads)
+            .field("seconds", seconds)
+            .field("ms_per_load", seconds * 1e3 / loads)
+            .field("mb_per_sec", bytes * loads / seconds / 1e6)
+            .print();
+    }
+
+    unlink(text_path.c_str());
+    unlink(rle_path.c_str());
+    unlink(checkpoint_path.c_str());
+}
+
+// bench_render function that times full and lazy displays of a canvas,
+// with frames where every tile changes and frames where 1% of tiles do.
+// the frames are worked out beforehand so that only painting and display
+// are timed. the canvas writes to stdout, so it is pointed at /dev/null
+// meanwhile
+void bench_render(size_t width, size_t height) {
+    const tui::RGB white{255, 255, 255};
+    const tui::RGB black{0, 0, 0};
+
+    // a random image and its inverse, which differ in every tile
+    std::mt19937 random(7);
+    std::bernoulli_distribution alive(0.35);
+    std::vector<tui::Tile> images[2];
+    for (size_t i = 0; i < width * height; ++i) {
+        bool on = alive(random);
+        images[0].push_back(on ? white : black);
+        images[1].push_back(on ? black : white);
+    }
+    // the tiles that flip in each frame where few change
+    std::vector<size_t> few;
+    for (size_t i = 0; i < width * height / 100; ++i) {
+        few.push_back(random() % (width * height));
+    }
+
+    struct Case { char const *name; bool lazy; bool heavy; };
+    const Case cases[] = {
+        {"full", false, true},
+        {"lazy_heavy", true, true},
+        {"lazy_light", true, false},
+    };
+
+    int saved_stdout = dup(STDOUT_FILENO);
+    int null = open("/dev/null", O_WRONLY);
+    for (Case const &c : cases) {
+        tui::Canvas canvas(width, height);
+        uint64_t frame = 0;
+
+        dup2(null, STDOUT_FILENO);
+        canvas.full_display();
+        double seconds;
+        uint64_t frames = repeat([&] {
+            std::vector<tui::Tile> const &image = images[++frame & 1];
+            if (c.heavy) {
+                for (size_t y = 0; y < height; ++y) {
+                    for (size_t x = 0; x < width; ++x) {
+                        canvas(x, y) = image[y * width + x];
+                    }
+                }
+            } else {
+                for (size_t i : few) {
+                    canvas(i % width, i / width) = image[i];
+                }
+            }
+            if (c.lazy) {
+                canvas.lazy_display();
+            } else {
+                canvas.full_display();
+            }
+        }, seconds);
+        dup2(saved_stdout, STDOUT_FILENO);
+
+        Result("render")
+            .field("mode", c.name)
+            .field("width", width)
+            .field("height", height)
+            .field("frames", frames)
+            .field("seconds", seconds)
+            .field("us_per_frame", seconds * 1e6 / frames)
+            .field("bytes_per_frame", (double) canvas.get_total_bytes() / canvas.get_frame_count())
+            .print();
+    }
+    close(null);
+    close(saved_stdout);
+}
+
+// main function
+int main(int argc, char *argv[]) {
+
+    // --quick runs smaller boards for less time, for a fast smoke test
+    bool quick = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--quick") {
+            quick = true;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--quick]\n";
+            return 1;
+        }
+    }
+    if (quick) {
+        min_time = 0.05;
+    }
+
+    bench_step(quick ? std::vector<int>{256} : std::vector<int>{256, 1024, 4096}, quick ? 32 : 100);
+    bench_update_tile(quick ? 128 : 512);
+    bench_load(quick ? 512 : 2048);
+    bench_render(200, 60);
+    return 0;
+}
@@ -0,0 +1,234 @@
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "checkpoint.h"
+
+static_assert(sizeof(CheckpointHeader) == 64, "checkpoint header must stay 64 bytes");
+
+// desc : Returns a checksum of the input words. Four independent lanes
+//        are mixed so that the multiplies can overlap, then folded
+//        together at the end.
+// pre  : None
+// post : None, aside from description
+static uint64_t checksum(uint64_t const *words, size_t count) {
+    const uint64_t prime = 0x9E3779B97F4A7C15ull;
+    uint64_t lanes[4] = { 1, 2, 3, 4 };
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        for (int l=0; l<4; l++) {
+            lanes[l] = (lanes[l] ^ words[i+l]) * prime;
+            lanes[l] ^= lanes[l] >> 29;
+        }
+    }
+    for (; i < count; i++) {
+        lanes[0] = (lanes[0] ^ words[i]) * prime;
+        lanes[0] ^= lanes[0] >> 29;
+    }
+    uint64_t total = count;
+    for (int l=0; l<4; l++) {
+        total = (total ^ lanes[l]) * prime;
+        total ^= total >> 32;
+    }
+    return total;
+}
+
+// desc : Writes all `size` bytes of `data` to the input file, retrying
+//        after partial writes, and returns whether it succeeded
+// pre  : None
+// post : None, aside from description
+static bool write_all(int fd, void const *data, size_t size) {
+    char const *cursor = (char const *) data;
+    while (size > 0) {
+        ssize_t count = write(fd, cursor, size);
+        if (count <= 0) {
+            return false;
+        }
+        cursor += count;
+        size   -= count;
+    }
+    return true;
+}
+
+// desc : Writes the input grid to a checkpoint at `path`, through a
+//        temporary file that is renamed into place once it is on disk
+// pre  : None
+// post : Throws a std::runtime_error if the file can't be written
+void write_checkpoint(std::string path, Grid &grid, uint64_t generation, int rule) {
+    CheckpointHeader header = {};
+    std::memcpy(header.magic, checkpoint_magic, sizeof(header.magic));
+    header.version    = checkpoint_version;
+    header.rule       = rule;
+    header.width      = grid.get_width();
+    header.height     = grid.get_height();
+    header.generation = generation;
+    header.checksum   = checksum(grid.get_buffer(), grid.get_buffer_words());
+
+    std::string temp_path = path + ".tmp";
+    int fd = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot create checkpoint file");
+    }
+    bool written = write_all(fd, &header, sizeof(header))
+                && write_all(fd, grid.get_buffer(), grid.get_buffer_words() * sizeof(uint64_t))
+                && (fsync(fd) == 0);
+    written = (close(fd) == 0) && written;
+    if (!written || (rename(temp_path.c_str(), path.c_str()) != 0)) {
+        unlink(temp_path.c_str());
+        throw std::runtime_error("Cannot write checkpoint file");
+    }
+}
+
+// desc : Resumes the checkpoint at `path` from a private mapping of the
+//        file, checking its header first, and its checksum if `verify`
+//        is set
+// pre  : None
+// post : Throws a std::runtime_error if the file can't be read or isn't
+//        a valid checkpoint. The caller owns the returned grid.
+Grid *read_checkpoint(std::string path, uint64_t &generation, int &rule, bool verify) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open file");
+    }
+    struct stat info;
+    if ((fstat(fd, &info) != 0) || ((size_t) info.st_size < sizeof(CheckpointHeader))) {
+        close(fd);
+        throw std::runtime_error("Not a checkpoint file");
+    }
+    size_t size = info.st_size;
+
+    // Pages stay shared with the page cache until the grid writes to
+    // them, at which point the process gets its own copy
+    void *mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("Cannot map file");
+    }
+
+    CheckpointHeader header;
+    std::memcpy(&header, mapping, sizeof(header));
+    char const *problem = nullptr;
+    if (std::memcmp(header.magic, checkpoint_magic, sizeof(header.magic)) != 0) {
+        problem = "Not a checkpoint file";
+    } else if (header.version != checkpoint_version) {
+        problem = "Unsupported checkpoint version";
+    } else if ((header.width < 0) || (header.height < 0)
+            || (header.width > INT32_MAX - 64) || (header.height > INT32_MAX - 2)
+            || (size != sizeof(header) + (size_t) ((header.width + 63) / 64 + 2)
+                                       * (header.height + 2) * sizeof(uint64_t))) {
+        problem = "Checkpoint file has the wrong size";
+    }
+    if (problem != nullptr) {
+        munmap(mapping, size);
+        throw std::runtime_error(problem);
+    }
+
+    Grid *grid = new Grid(header.width, header.height, mapping, size, sizeof(header));
+    if (verify) {
+        madvise(mapping, size, MADV_SEQUENTIAL);
+        if (checksum(grid->get_buffer(), grid->get_buffer_words()) != header.checksum) {
+            delete grid;
+            throw std::runtime_error("Checkpoint file is corrupt");
+        }
+        madvise(mapping, size, MADV_NORMAL);
+    }
+
+    generation = header.generation;
+    rule       = header.rule;
+    return grid;
+}
+
+// desc : Starts the background thread
+// pre  : None
+// post : None, aside from description
+CheckpointWriter::CheckpointWriter()
+    : pending(nullptr)
+    , pending_generation(0)
+    , pending_rule(0)
+    , writing(false)
+    , stopping(false)
+    , thread(&CheckpointWriter::work, this)
+{}
+
+// desc : Writes any pending snapshot, then stops the background thread
+// pre  : None
+// post : None, aside from description
+CheckpointWriter::~CheckpointWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cond.notify_all();
+    thread.join();
+}
+
+// desc : Queues the input snapshot to be written, dropping any older
+//        snapshot still waiting
+// pre  : `snapshot` must have been allocated with `new`
+// post : None, aside from description
+void CheckpointWriter::save(Grid *snapshot, std::string path, uint64_t generation, int rule) {
+    Grid *dropped;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        dropped            = pending;
+        pending            = snapshot;
+        pending_path       = path;
+        pending_generation = generation;
+        pending_rule       = rule;
+    }
+    cond.notify_all();
+    delete dropped;
+}
+
+// desc : Blocks until every queued snapshot has been written
+// pre  : None
+// post : None, aside from description
+void CheckpointWriter::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    cond.wait(lock, [this] { return (pending == nullptr) && !writing; });
+}
+
+// desc : Returns the message of the last failed write, or an empty
+//        string if the last write succeeded
+// pre  : None
+// post : None, aside from description
+std::string CheckpointWriter::last_error() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return error;
+}
+
+// desc : Writes snapshots as they arrive, outside the lock, until the
+//        writer is stopped with nothing left to write
+// pre  : None
+// post : None, aside from description
+void CheckpointWriter::work() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        cond.wait(lock, [this] { return (pending != nullptr) || stopping; });
+        if (pending == nullptr) {
+            return;
+        }
+        Grid       *snapshot   = pending;
+        std::string path       = pending_path;
+        uint64_t    generation = pending_generation;
+        int         rule       = pending_rule;
+        pending = nullptr;
+        writing = true;
+
+        lock.unlock();
+        std::string failure;
+        try {
+            write_checkpoint(path, *snapshot, generation, rule);
+        } catch (std::runtime_error &e) {
+            failure = e.what();
+        }
+        delete snapshot;
+        lock.lock();
+
+        error   = failure;
+        writing = false;
+        cond.notify_all();
+    }
+}
@@ -0,0 +1,125 @@
+#ifndef CHECKPOINT
+#define CHECKPOINT
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "grid.h"
+
+///////////////////////////////////////////////////////////
+// The binary checkpoint format.
+//
+// A checkpoint is this header followed by the grid's whole
+// buffer, padding included, exactly as it is laid out in
+// memory. This lets a checkpoint be resumed by mapping the
+// file and handing the mapping to a Grid, without parsing or
+// copying the tiles. The checksum covers the buffer.
+///////////////////////////////////////////////////////////
+struct CheckpointHeader {
+    char     magic[8];
+    uint32_t version;
+    int32_t  rule;
+    int64_t  width;
+    int64_t  height;
+    uint64_t generation;
+    uint64_t checksum;
+    // Keeps the buffer 64-byte aligned within the file
+    uint64_t reserved[2];
+};
+
+const char     checkpoint_magic[8]  = { 'P', '3', 'C', 'K', 'P', 'T', '\r', '\n' };
+const uint32_t checkpoint_version   = 1;
+
+// desc : Writes the input grid to a checkpoint at `path`, along with the
+//        generation it holds and the rule it evolves under. The file is
+//        written under a temporary name, flushed to disk, and renamed into
+//        place, so an interrupted write never replaces a good checkpoint.
+// pre  : None
+// post : Throws a std::runtime_error if the file can't be written
+void write_checkpoint(std::string path, Grid &grid, uint64_t generation, int rule);
+
+// desc : Resumes the checkpoint at `path`, returning a grid that adopts
+//        a private mapping of the file and setting `generation` and
+//        `rule` from its header. The tiles are never copied, and pages
+//        are only duplicated once the grid writes to them. If `verify`
+//        is set, the checksum is checked first, which reads the whole
+//        file; otherwise only the header is read.
+// pre  : None
+// post : Throws a std::runtime_error if the file can't be read or isn't
+//        a valid checkpoint. The caller owns the returned grid.
+Grid *read_checkpoint(std::string path, uint64_t &generation, int &rule, bool verify = true);
+
+///////////////////////////////////////////////////////////
+// Writes checkpoints on a background thread, so that saving
+// a large grid never holds up the simulation.
+//
+// Callers hand over a snapshot of the grid, which is cheap
+// to take compared to checksumming it and writing it out.
+// If a new snapshot arrives while an older one is still
+// waiting to be written, the older one is dropped, since it
+// would be overwritten straight away.
+///////////////////////////////////////////////////////////
+class CheckpointWriter {
+
+    // Guards everything below
+    std::mutex              mutex;
+    std::condition_variable cond;
+
+    // The snapshot waiting to be written, if any, and the details
+    // stored alongside it
+    Grid                   *pending;
+    std::string             pending_path;
+    uint64_t                pending_generation;
+    int                     pending_rule;
+
+    // Whether a snapshot is being written right now
+    bool                    writing;
+    // Set when the writer is being destroyed
+    bool                    stopping;
+
+    // The message of the last failed write, or empty if the last
+    // write succeeded
+    std::string             error;
+
+    std::thread             thread;
+
+    // desc : The loop run by the background thread, writing snapshots
+    //        as they arrive until the writer is destroyed
+    // pre  : None
+    // post : None, aside from description
+    void work();
+
+    public:
+
+    // desc : Starts the background thread
+    // pre  : None
+    // post : None, aside from description
+    CheckpointWriter();
+
+    // desc : Writes any pending snapshot, then stops the background
+    //        thread
+    // pre  : None
+    // post : None, aside from description
+    ~CheckpointWriter();
+
+    // desc : Queues the input snapshot to be written to `path`, taking
+    //        ownership of it, and returns immediately
+    // pre  : `snapshot` must have been allocated with `new`
+    // post : None, aside from description
+    void save(Grid *snapshot, std::string path, uint64_t generation, int rule);
+
+    // desc : Blocks until every queued snapshot has been written
+    // pre  : None
+    // post : None, aside from description
+    void wait();
+
+    // desc : Returns the message of the last failed write, or an empty
+    //        string if the last write succeeded
+    // pre  : None
+    // post : None, aside from description
+    std::string last_error();
+};
+
+#endif //CHECKPOINT
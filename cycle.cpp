@@ -0,0 +1,73 @@
+#include "cycle.h"
+
+// desc : Creates a detector that remembers the last `capacity` states
+// pre  : `capacity` must be positive
+// post : None, aside from description
+CycleDetector::CycleDetector(size_t capacity)
+    : capacity(capacity)
+    , found(false)
+    , period(0)
+    , start(0)
+{
+}
+
+// desc : Looks the hash up among the remembered states, then remembers
+//        it, forgetting the oldest state once there are too many
+// pre  : Generations must be recorded in increasing order
+// post : None, aside from description
+bool CycleDetector::record(uint64_t hash, uint64_t generation) {
+    if (found) {
+        return false;
+    }
+    auto earlier = seen.find(hash);
+    if (earlier != seen.end()) {
+        found  = true;
+        start  = earlier->second;
+        period = generation - start;
+        return true;
+    }
+
+    seen[hash] = generation;
+    order.emplace_back(hash, generation);
+    if (order.size() > capacity) {
+        auto [oldest_hash, oldest_generation] = order.front();
+        order.pop_front();
+        auto oldest = seen.find(oldest_hash);
+        if ((oldest != seen.end()) && (oldest->second == oldest_generation)) {
+            seen.erase(oldest);
+        }
+    }
+    return false;
+}
+
+// desc : Forgets every state and any cycle found
+// pre  : None
+// post : None, aside from description
+void CycleDetector::reset() {
+    seen.clear();
+    order.clear();
+    found  = false;
+    period = 0;
+    start  = 0;
+}
+
+// desc : Returns whether a cycle was found
+// pre  : None
+// post : None, aside from description
+bool CycleDetector::get_found() {
+    return found;
+}
+
+// desc : Returns the number of generations in the cycle found
+// pre  : `get_found` must return true
+// post : None, aside from description
+uint64_t CycleDetector::get_period() {
+    return period;
+}
+
+// desc : Returns the first generation of the cycle found
+// pre  : `get_found` must return true
+// post : None, aside from description
+uint64_t CycleDetector::get_start() {
+    return start;
+}
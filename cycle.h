@@ -0,0 +1,74 @@
+#ifndef CYCLE
+#define CYCLE
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <utility>
+
+///////////////////////////////////////////////////////////
+// Notices when a pattern returns to a state it was in
+// before, from the hashes of its recent states.
+//
+// Each generation's hash is looked up among the last
+// `capacity` recorded. The first repeat found is the first
+// generation of the second time around the cycle, so the
+// generation it repeats is where the cycle starts and the
+// difference is its period. Periods longer than the history
+// go unnoticed. When states are only recorded every k
+// generations, the period found is the smallest multiple of
+// k that the true period divides.
+///////////////////////////////////////////////////////////
+class CycleDetector {
+
+    // The most recent generation recorded with each hash, and the
+    // hashes and generations in the order they were recorded
+    std::unordered_map<uint64_t, uint64_t>      seen;
+    std::deque<std::pair<uint64_t, uint64_t>>   order;
+
+    // The number of states remembered
+    size_t   capacity;
+
+    // Whether a cycle was found, its period, and the generation it starts
+    bool     found;
+    uint64_t period;
+    uint64_t start;
+
+    public:
+
+    // desc : Creates a detector that remembers the last `capacity` states
+    // pre  : `capacity` must be positive
+    // post : None, aside from description
+    CycleDetector(size_t capacity);
+
+    // desc : Records the hash of the state at the input generation,
+    //        returning true if it completes a cycle. Once a cycle is found,
+    //        nothing more is recorded until `reset`.
+    // pre  : Generations must be recorded in increasing order
+    // post : None, aside from description
+    bool record(uint64_t hash, uint64_t generation);
+
+    // desc : Forgets every state and any cycle found, for use when the
+    //        pattern starts evolving differently, such as under a new rule
+    // pre  : None
+    // post : None, aside from description
+    void reset();
+
+    // desc : Returns whether a cycle was found
+    // pre  : None
+    // post : None, aside from description
+    bool get_found();
+
+    // desc : Returns the number of generations in the cycle found
+    // pre  : `get_found` must return true
+    // post : None, aside from description
+    uint64_t get_period();
+
+    // desc : Returns the first generation of the cycle found
+    // pre  : `get_found` must return true
+    // post : None, aside from description
+    uint64_t get_start();
+};
+
+#endif //CYCLE
@@ -0,0 +1,564 @@
+#include <algorithm>
+#include <atomic>
+#include "engine.h"
+#include "kernel.h"
+
+// A rule under which a tile is alive if it or any of its neighbors
+// were alive (births on 1-8 neighbors, survival on 0-8). Stepping a
+// change map with it flags every word next to a changed word.
+static const int dilate_rule = 0x3FFFE;
+
+// The size of the tiles stepped by blocked steps: the number of words
+// across, and the number of rows down for each generation in a block.
+// Tiles grow taller with the block so that the rows recomputed above and
+// below each tile stay a small fraction of it.
+static const int tile_words         = 16;
+static const int tile_rows_per_step = 8;
+static const int min_tile_rows      = 32;
+
+// desc : Frees any resources held by the engine
+// pre  : None
+// post : None, aside from description
+Engine::~Engine() {}
+
+// desc : Returns a copy of the visible state within the initial
+//        pattern's bounds as a new grid, built tile by tile
+// pre  : The caller must keep `commit` from running concurrently
+// post : None, aside from description
+Grid *Engine::snapshot() {
+    Grid *grid = new Grid(get_width(), get_height());
+    for (int64_t y = 0; y < get_height(); y++) {
+        for (int64_t x = 0; x < get_width(); x++) {
+            if (get_tile(x, y)) {
+                grid->set_tile(x, y, true);
+            }
+        }
+    }
+    return grid;
+}
+
+// desc : Reports that the pattern may leave the initial pattern's bounds
+// pre  : None
+// post : None, aside from description
+bool Engine::stays_in_bounds() {
+    return false;
+}
+
+// desc : Reports that the engine can step under any rule
+// pre  : None
+// post : None, aside from description
+bool Engine::supports_rule(int) {
+    return true;
+}
+
+// desc : Estimates the fraction of live tiles in the square from a 4x4
+//        grid of evenly spaced tiles, or fewer for small squares
+// pre  : `scale` must be a power of two, and both coordinates must be
+//        multiples of it
+// post : None, aside from description
+double Engine::density(int64_t x, int64_t y, int64_t scale) {
+    int64_t spacing = std::max<int64_t>(1, scale / 4);
+    int     live    = 0;
+    int     samples = 0;
+    for (int64_t j = spacing / 2; j < scale; j += spacing) {
+        for (int64_t i = spacing / 2; i < scale; i += spacing) {
+            live += get_tile(x + i, y + j);
+            samples++;
+        }
+    }
+    return double(live) / samples;
+}
+
+// desc : Reports that the rectangle may have changed, since nothing is
+//        known about which tiles did
+// pre  : None
+// post : None, aside from description
+bool Engine::area_changed(int64_t, int64_t, int64_t, int64_t) {
+    return true;
+}
+
+// desc : Reports that the number of changed tiles isn't kept track of
+// pre  : None
+// post : None, aside from description
+int64_t Engine::changed_tiles() {
+    return -1;
+}
+
+// desc : Reports that the engine steps on the calling thread alone
+// pre  : None
+// post : None, aside from description
+WorkerPool *Engine::get_pool() {
+    return nullptr;
+}
+
+// desc : Reports that the engine keeps no state hash
+// pre  : None
+// post : None, aside from description
+bool Engine::state_hash(uint64_t &) {
+    return false;
+}
+
+// desc : Scrambles the bits of the input, so that inputs differing in
+//        any bit give unrelated outputs (the SplitMix64 finalizer)
+// pre  : None
+// post : None, aside from description
+static uint64_t mix(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+// desc : Returns the contribution of a word of tiles to a state hash,
+//        mixing the word with a scrambled copy of its index so that the
+//        same word at different places contributes differently. Dead
+//        words contribute nothing.
+// pre  : None
+// post : None, aside from description
+uint64_t word_hash(uint64_t index, uint64_t word) {
+    return (word == 0) ? 0 : mix(word ^ mix(index + 1));
+}
+
+
+// desc : Returns a mask of the tiles of word `w` of each row of `grid`
+//        that are inside the grid, which leaves out the ghost tile that
+//        may sit past the last tile of a row
+// pre  : None
+// post : None, aside from description
+static uint64_t inside_mask(Grid &grid, int w) {
+    int tail = grid.get_width() & 63;
+    if ((w != grid.get_words() - 1) || (tail == 0)) {
+        return ~uint64_t(0);
+    }
+    return (uint64_t(1) << tail) - 1;
+}
+
+// desc : Creates an engine evolving the input grid, taking ownership
+//        of it, and taking it to be generation `generation` of the
+//        pattern. The grid's edges connect as `topology` says, and
+//        each step covers `time_block` generations.
+// pre  : `grid` must have been allocated with `new`, and `time_block`
+//        must be in the range [1,64], and 1 unless the grid is bounded
+// post : None, aside from description
+GridEngine::GridEngine(Grid *grid, uint64_t generation, Topology topology, int time_block)
+    : prev(grid)
+    , next(new Grid(grid->get_width(), grid->get_height()))
+    , changed(new Grid(grid->get_words(), grid->get_height()))
+    , changed_next(new Grid(grid->get_words(), grid->get_height()))
+    , dirty(new Grid(grid->get_words(), grid->get_height()))
+    , last_rule(-1)
+    , last_block(1)
+    , topology(topology)
+    , time_block(time_block)
+    , pyramid(grid->get_width(), grid->get_height())
+    , changed_count(0)
+    , hash(0)
+    , pool(0)
+    , generation(generation)
+{
+    prev->fill_ghosts(topology);
+    build_pyramid();
+}
+
+// desc : Frees the grids and change maps
+// pre  : None
+// post : None, aside from description
+GridEngine::~GridEngine() {
+    delete prev;
+    delete next;
+    delete changed;
+    delete changed_next;
+    delete dirty;
+}
+
+// desc : Counts every block of the population pyramid, and hashes the
+//        visible generation, from scratch
+// pre  : None
+// post : None, aside from description
+void GridEngine::build_pyramid() {
+    int words  = prev->get_words();
+    int height = prev->get_height();
+
+    // Each word of a row is one row of a 64x64 block
+    std::vector<uint64_t> blocks(size_t(words) * ((height + 63) / 64), 0);
+    hash = 0;
+    for (int y = 0; y < height; y++) {
+        uint64_t *row = prev->row(y);
+        for (int w = 0; w < words; w++) {
+            uint64_t tiles = row[w] & inside_mask(*prev, w);
+            blocks[(y >> 6) * words + w] += __builtin_popcountll(tiles);
+            hash ^= word_hash(uint64_t(y) * words + w, tiles);
+        }
+    }
+    pyramid.assign(blocks);
+}
+
+// desc : Adds the population change of every word flagged in `changed`
+//        between `next` and `prev` to the pyramid, counts the tiles that
+//        changed into `changed_count`, and swaps each changed word's old
+//        contribution to `hash` for its new one
+// pre  : `prev` must hold the generation after `next`, and `changed`
+//        the words that differ between them
+// post : None, aside from description
+void GridEngine::update_pyramid() {
+    int    words      = prev->get_words();
+    int    flag_words = changed->get_words();
+    changed_count     = 0;
+    for (int y = 0; y < prev->get_height(); y++) {
+        uint64_t *flags = changed->row(y);
+        for (int j = 0; j < flag_words; j++) {
+            for (uint64_t bits = flags[j]; bits != 0; bits &= bits - 1) {
+                int w = j * 64 + __builtin_ctzll(bits);
+                if (w >= words) {
+                    break;
+                }
+                uint64_t mask   = inside_mask(*prev, w);
+                uint64_t after  = prev->row(y)[w] & mask;
+                uint64_t before = next->row(y)[w] & mask;
+                int64_t  delta  = int64_t(__builtin_popcountll(after)) - int64_t(__builtin_popcountll(before));
+                changed_count += __builtin_popcountll(after ^ before);
+                hash ^= word_hash(uint64_t(y) * words + w, before) ^ word_hash(uint64_t(y) * words + w, after);
+                if (delta != 0) {
+                    pyramid.add(w, y >> 6, delta);
+                }
+            }
+        }
+    }
+}
+
+// desc : Computes the next generation into `next`, splitting the rows
+//        of the grid into bands, several per thread so that uneven
+//        bands even out, and updating each band as a task. Within a
+//        band, each row only steps the words flagged as dirty.
+// pre  : Any step computed previously must have been committed
+// post : None, aside from description
+void GridEngine::step(int rule) {
+    if (time_block > 1) {
+        step_blocked(rule);
+        return;
+    }
+    if ((rule != last_rule) || (last_block != 1)) {
+        changed->fill(true);
+        changed->fill_ghosts(topology);
+        last_rule  = rule;
+        last_block = 1;
+    }
+
+    size_t y_limit = prev->get_height();
+    size_t bands = std::min(y_limit, pool.size() * 4);
+    if (bands == 0) {
+        return;
+    }
+    size_t band_height = (y_limit + bands - 1) / bands;
+
+    // Returns once every band has been updated
+    pool.run(bands, [this, y_limit, band_height, rule](size_t band) {
+        size_t y_end = std::min(y_limit, (band + 1) * band_height);
+        int flag_words = changed->get_words();
+        for (size_t y = band * band_height; y < y_end; y++) {
+            // Rows with no changes in or next to them need no work at all
+            bool quiet = true;
+            for (int j = -1; j <= 1; j++) {
+                uint64_t *flags = changed->row(y + j);
+                for (int w = 0; w < flag_words; w++) {
+                    quiet = quiet && (flags[w] == 0);
+                }
+            }
+            if (quiet) {
+                std::fill(changed_next->row(y), changed_next->row(y) + flag_words, 0);
+                continue;
+            }
+            dirty->update_row(*changed, y, dilate_rule);
+            next->update_words(*prev, y, dirty->row(y), changed_next->row(y), rule);
+        }
+    });
+}
+
+// desc : Computes the generation `time_block` generations after `prev`
+//        into `next`, splitting the grid into tiles and stepping each
+//        tile as a task
+// pre  : The grid must be bounded, and any step computed previously must
+//        have been committed
+// post : None, aside from description
+void GridEngine::step_blocked(int rule) {
+    // Tiles whose surroundings didn't change can only be skipped if the
+    // change map covers a block of the same length under the same rule
+    bool reuse = (rule == last_rule) && (last_block == time_block);
+    last_rule  = rule;
+    last_block = time_block;
+
+    // Tiles flag their words themselves, so flags start cleared
+    changed_next->fill(false);
+
+    int words     = prev->get_words();
+    int height    = prev->get_height();
+    int tile_rows = std::max(min_tile_rows, tile_rows_per_step * time_block);
+    int tiles_x   = (words  + tile_words - 1) / tile_words;
+    int tiles_y   = (height + tile_rows  - 1) / tile_rows;
+
+    // Returns once every tile has been stepped
+    pool.run(size_t(tiles_x) * tiles_y, [=, this](size_t tile) {
+        int w = (tile % tiles_x) * tile_words;
+        int y = (tile / tiles_x) * tile_rows;
+        step_tile(w, y, std::min(tile_words, words - w), std::min(tile_rows, height - y), rule, reuse);
+    });
+}
+
+// desc : Copies one tile and the tiles within `time_block` of it into
+//        scratch space, steps the copy `time_block` times, and writes the
+//        tile back to `next`. The copy is a word wider than the tile on
+//        each side, which covers blocks of up to 64 generations. Each
+//        generation computes two fewer rows than the last, since the
+//        outermost rows no longer have up to date neighbors, and tiles
+//        outside the grid are cleared after every generation to keep
+//        them dead.
+// pre  : The grid must be bounded, `time_block` must be at most 64, and
+//        any step computed previously must have been committed
+// post : None, aside from description
+void GridEngine::step_tile(int w, int y, int words, int rows, int rule, bool reuse) {
+    int k           = time_block;
+    int grid_words  = prev->get_words();
+    int grid_height = prev->get_height();
+
+    // When the last step left this tile's surroundings unchanged, the
+    // next step leaves the tile unchanged too, and `next`, being a step
+    // older than `prev`, already holds it
+    if (reuse) {
+        int  w_begin = std::max(w - 1, 0);
+        int  w_end   = std::min(w + words + 1, grid_words);
+        int  y_begin = std::max(y - k, 0);
+        int  y_end   = std::min(y + rows + k, grid_height);
+        bool quiet   = true;
+        for (int row = y_begin; quiet && (row < y_end); row++) {
+            uint64_t *flags = changed->row(row);
+            for (int i = w_begin; i < w_end; i++) {
+                quiet = quiet && !((flags[i >> 6] >> (i & 63)) & 1);
+            }
+        }
+        if (quiet) {
+            return;
+        }
+    }
+
+    // Scratch rows hold `span` words, starting a word left of the tile,
+    // between two dead padding words for the kernel to read
+    int    span   = words + 2;
+    int    stride = span + 2;
+    int    height = rows + 2 * k;
+    std::vector<uint64_t> scratch(size_t(2) * height * stride, 0);
+    uint64_t *src = scratch.data();
+    uint64_t *dst = scratch.data() + size_t(height) * stride;
+
+    // Scratch row r is grid row y-k+r, and scratch word c is grid word
+    // w-1+c. Words outside the grid are masked to dead.
+    std::vector<uint64_t> masks(span);
+    for (int c = 0; c < span; c++) {
+        int gw   = w - 1 + c;
+        masks[c] = ((gw >= 0) && (gw < grid_words)) ? inside_mask(*prev, gw) : 0;
+    }
+    int first = std::max(0, k - y);
+    int last  = std::min(height, grid_height - y + k);
+    for (int r = first; r < last; r++) {
+        uint64_t *from = prev->row(y - k + r) + (w - 1);
+        for (int c = 0; c < span; c++) {
+            src[r * stride + 1 + c] = masks[c] ? (from[c] & masks[c]) : 0;
+        }
+    }
+
+    // Rows outside the grid are never computed, so they stay dead
+    for (int g = 1; g <= k; g++) {
+        for (int r = std::max(g, first); r < std::min(height - g, last); r++) {
+            uint64_t *out = dst + r * stride + 1;
+            step_row(src + (r - 1) * stride + 1, src + r * stride + 1, src + (r + 1) * stride + 1,
+                     out, span, rule);
+            for (int c = 0; c < span; c++) {
+                out[c] &= masks[c];
+            }
+        }
+        std::swap(src, dst);
+    }
+
+    // Write the tile back, flagging the words that differ from `prev`.
+    // Neighboring tiles may share a flag word, so flags are set
+    // atomically.
+    for (int r = k; r < k + rows; r++) {
+        uint64_t *before = prev->row(y - k + r) + w;
+        uint64_t *after  = next->row(y - k + r) + w;
+        uint64_t *flags  = changed_next->row(y - k + r);
+        for (int i = 0; i < words; i++) {
+            uint64_t value = src[r * stride + 2 + i];
+            after[i] = value;
+            if ((value ^ before[i]) & masks[1 + i]) {
+                std::atomic_ref<uint64_t>(flags[(w + i) >> 6])
+                    .fetch_or(uint64_t(1) << ((w + i) & 63), std::memory_order_relaxed);
+            }
+        }
+    }
+}
+
+// desc : Swaps the freshly computed generation and its change map
+//        into view, brings the population pyramid up to date, then fills
+//        the ghost tiles of both for the next step
+// pre  : `step` must have been called since the last commit
+// post : None, aside from description
+void GridEngine::commit() {
+    std::swap(prev, next);
+    std::swap(changed, changed_next);
+    update_pyramid();
+    prev->fill_ghosts(topology);
+    changed->fill_ghosts(topology);
+    generation += last_block;
+}
+
+// desc : Returns whether or not the tile at the input coordinates
+//        is alive, treating everything outside the grid as dead
+// pre  : None
+// post : None, aside from description
+bool GridEngine::get_tile(int64_t x, int64_t y) {
+    if ((x < 0) || (x >= prev->get_width()) || (y < 0) || (y >= prev->get_height())) {
+        return false;
+    }
+    return prev->get_tile(x, y);
+}
+
+// desc : Returns the width of the grid
+// pre  : None
+// post : None, aside from description
+int64_t GridEngine::get_width() {
+    return prev->get_width();
+}
+
+// desc : Returns the height of the grid
+// pre  : None
+// post : None, aside from description
+int64_t GridEngine::get_height() {
+    return prev->get_height();
+}
+
+// desc : Returns the number of live tiles in the visible generation, as
+//        counted by the top of the population pyramid
+// pre  : None
+// post : None, aside from description
+uint64_t GridEngine::population() {
+    return pyramid.total();
+}
+
+// desc : Returns the number of committed generations
+// pre  : None
+// post : None, aside from description
+uint64_t GridEngine::get_generation() {
+    return generation;
+}
+
+// desc : Returns the engine's name, thread count, kernel, topology, and
+//        the generations each step covers if more than one
+// pre  : None
+// post : None, aside from description
+std::string GridEngine::describe() {
+    char const *shape = (topology == Topology::torus) ? "torus"
+                      : (topology == Topology::klein) ? "klein bottle"
+                      : "bounded";
+    std::string block = (time_block > 1) ? ", " + std::to_string(time_block) + " generations per step" : "";
+    return "grid (" + std::to_string(pool.size()) + " threads, "
+         + kernel_name() + " kernel, " + shape + block + ")";
+}
+
+// desc : Returns a copy of the visible generation, copied a buffer at
+//        a time
+// pre  : The caller must keep `commit` from running concurrently
+// post : None, aside from description
+Grid *GridEngine::snapshot() {
+    // Snapshots hold no ghost tiles, whatever the topology
+    Grid *grid = new Grid(*prev);
+    grid->fill_ghosts(Topology::bounded);
+    return grid;
+}
+
+// desc : Reports that the pattern never leaves the grid
+// pre  : None
+// post : None, aside from description
+bool GridEngine::stays_in_bounds() {
+    return true;
+}
+
+// desc : Returns the fraction of live tiles in the square, counting the
+//        tiles of squares narrower than a word directly and looking
+//        larger squares up in the population pyramid
+// pre  : `scale` must be a power of two, and both coordinates must be
+//        multiples of it
+// post : None, aside from description
+double GridEngine::density(int64_t x, int64_t y, int64_t scale) {
+    if ((x < 0) || (x >= prev->get_width()) || (y < 0) || (y >= prev->get_height())) {
+        return 0;
+    }
+    uint64_t count = 0;
+    if (scale < 64) {
+        int      w     = x >> 6;
+        uint64_t mask  = (((uint64_t(1) << scale) - 1) << (x & 63)) & inside_mask(*prev, w);
+        int64_t  y_end = std::min<int64_t>(y + scale, prev->get_height());
+        for (int64_t row = y; row < y_end; row++) {
+            count += __builtin_popcountll(prev->row(row)[w] & mask);
+        }
+    } else {
+        count = pyramid.count(x, y, scale);
+    }
+    return double(count) / (double(scale) * double(scale));
+}
+
+// desc : Returns whether any word overlapping the rectangle is flagged
+//        in the change map of the visible generation, checking the flags
+//        of a row 64 words at a time
+// pre  : None
+// post : None, aside from description
+bool GridEngine::area_changed(int64_t x, int64_t y, int64_t width, int64_t height) {
+    int64_t x_end = std::min<int64_t>(x + width,  prev->get_width());
+    int64_t y_end = std::min<int64_t>(y + height, prev->get_height());
+    x = std::max<int64_t>(x, 0);
+    y = std::max<int64_t>(y, 0);
+    if ((x >= x_end) || (y >= y_end)) {
+        return false;
+    }
+
+    // Word `w` of a row is flagged by bit w&63 of flag word w>>6
+    int64_t first = x >> 6;
+    int64_t last  = (x_end - 1) >> 6;
+    for (int64_t row = y; row < y_end; row++) {
+        uint64_t *flags = changed->row(row);
+        for (int64_t j = first >> 6; j <= (last >> 6); j++) {
+            uint64_t mask = ~uint64_t(0);
+            if (j == (first >> 6)) {
+                mask &= ~uint64_t(0) << (first & 63);
+            }
+            if (j == (last >> 6)) {
+                mask &= ~uint64_t(0) >> (63 - (last & 63));
+            }
+            if (flags[j] & mask) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// desc : Returns the number of tiles that changed in the last committed
+//        step
+// pre  : None
+// post : None, aside from description
+int64_t GridEngine::changed_tiles() {
+    return changed_count;
+}
+
+// desc : Returns the pool the engine steps with
+// pre  : None
+// post : None, aside from description
+WorkerPool *GridEngine::get_pool() {
+    return &pool;
+}
+
+// desc : Returns the hash of the visible generation, which commits keep
+//        up to date
+// pre  : None
+// post : None, aside from description
+bool GridEngine::state_hash(uint64_t &hash) {
+    hash = this->hash;
+    return true;
+}
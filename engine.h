@@ -0,0 +1,291 @@
+#ifndef ENGINE
+#define ENGINE
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "grid.h"
+#include "pool.h"
+#include "pyramid.h"
+
+///////////////////////////////////////////////////////////
+// Interface shared by every way of evolving a pattern.
+//
+// Stepping is split in two so that readers on other threads
+// never observe a half-computed generation: `step` computes
+// the next state out of sight, and `commit` makes it visible
+// to `get_tile`. Callers are expected to hold whatever lock
+// guards readers while calling `commit`.
+///////////////////////////////////////////////////////////
+class Engine {
+
+    public:
+
+    // desc : Frees any resources held by the engine
+    // pre  : None
+    // post : None, aside from description
+    virtual ~Engine();
+
+    // desc : Computes the state of the pattern one step after the
+    //        currently visible state, using the input rule. A step may
+    //        cover more than one generation.
+    // pre  : Any step computed previously must have been committed
+    // post : Throws a std::runtime_error if the engine can no longer
+    //        step, such as when a process stepping part of it has gone
+    //        away, after which it must only be read and deleted
+    virtual void step(int rule) = 0;
+
+    // desc : Makes the most recently computed step visible
+    // pre  : `step` must have been called since the last commit
+    // post : None, aside from description
+    virtual void commit() = 0;
+
+    // desc : Returns whether or not the tile at the input coordinates
+    //        is alive in the visible state. Coordinates are relative to
+    //        the top-left corner of the initial pattern, and tiles that
+    //        the engine does not track are reported as dead.
+    // pre  : None
+    // post : None, aside from description
+    virtual bool get_tile(int64_t x, int64_t y) = 0;
+
+    // desc : Returns the width of the initial pattern
+    // pre  : None
+    // post : None, aside from description
+    virtual int64_t get_width() = 0;
+
+    // desc : Returns the height of the initial pattern
+    // pre  : None
+    // post : None, aside from description
+    virtual int64_t get_height() = 0;
+
+    // desc : Returns the number of live tiles in the visible state
+    // pre  : None
+    // post : None, aside from description
+    virtual uint64_t population() = 0;
+
+    // desc : Returns the number of generations between the initial
+    //        pattern and the visible state
+    // pre  : None
+    // post : None, aside from description
+    virtual uint64_t get_generation() = 0;
+
+    // desc : Returns a short human-readable description of the engine
+    //        and its configuration
+    // pre  : None
+    // post : None, aside from description
+    virtual std::string describe() = 0;
+
+    // desc : Returns a copy of the visible state within the initial
+    //        pattern's bounds as a new grid, which the caller owns. The
+    //        default implementation copies it tile by tile.
+    // pre  : The caller must keep `commit` from running concurrently
+    // post : None, aside from description
+    virtual Grid *snapshot();
+
+    // desc : Returns whether the pattern can never leave the initial
+    //        pattern's bounds, so that `snapshot` holds all of it. The
+    //        default implementation returns false.
+    // pre  : None
+    // post : None, aside from description
+    virtual bool stays_in_bounds();
+
+    // desc : Returns whether the engine can step under the input rule.
+    //        The default implementation accepts every rule.
+    // pre  : None
+    // post : None, aside from description
+    virtual bool supports_rule(int rule);
+
+    // desc : Returns the fraction of live tiles in the `scale` by `scale`
+    //        square whose top-left corner is at the input coordinates,
+    //        for drawing zoomed-out views. The default implementation
+    //        estimates it from at most 16 evenly spaced tiles.
+    // pre  : `scale` must be a power of two, and both coordinates must be
+    //        multiples of it
+    // post : None, aside from description
+    virtual double density(int64_t x, int64_t y, int64_t scale);
+
+    // desc : Returns false if no tile in the `width` by `height` rectangle
+    //        whose top-left corner is at the input coordinates changed
+    //        between the previous visible state and the current one, and
+    //        true if any may have. The default implementation always
+    //        returns true.
+    // pre  : None
+    // post : None, aside from description
+    virtual bool area_changed(int64_t x, int64_t y, int64_t width, int64_t height);
+
+    // desc : Returns the number of tiles that changed between the previous
+    //        visible state and the current one, or -1 if the engine
+    //        doesn't keep track. The default implementation returns -1.
+    // pre  : None
+    // post : None, aside from description
+    virtual int64_t changed_tiles();
+
+    // desc : Returns the worker pool the engine steps with, or null if it
+    //        steps on the calling thread alone. The default implementation
+    //        returns null.
+    // pre  : None
+    // post : None, aside from description
+    virtual WorkerPool *get_pool();
+
+    // desc : Sets `hash` to a hash of the visible state and returns true,
+    //        or returns false if the engine doesn't keep one. Equal states
+    //        of the same engine have equal hashes. The default
+    //        implementation returns false.
+    // pre  : None
+    // post : None, aside from description
+    virtual bool state_hash(uint64_t &hash);
+};
+
+// desc : Returns the contribution of a word of tiles to a state hash,
+//        given the word's index within the grid. A state's hash is the XOR
+//        of the contributions of all of its words, so changing a word
+//        changes the hash by the XOR of its old and new contributions.
+//        Dead words contribute nothing.
+// pre  : None
+// post : None, aside from description
+uint64_t word_hash(uint64_t index, uint64_t word);
+
+
+
+
+///////////////////////////////////////////////////////////
+// Steps a bounded, bit-packed grid one generation at a time,
+// spreading bands of rows across a worker pool.
+//
+// Only words of the grid near activity are recomputed. Each
+// generation records which words changed in a change map,
+// itself a Grid with one tile per word, and the next
+// generation only steps the words flagged in the dilation of
+// that map (the changed words and their eight neighbors).
+// All other words already hold the right value, because the
+// buffer being overwritten is two generations old and those
+// words didn't change over the last generation.
+//
+// Edges are handled by filling the ghost tiles of the visible
+// generation and of its change map on every commit, so the
+// kernel never checks coordinates and changes near one edge
+// dirty the words across the opposite edge they wrap onto.
+//
+// Zoomed-out views read from a population pyramid, whose
+// bottom level counts the live tiles of every 64x64 block
+// and whose every other level sums 2x2 groups of the level
+// below. Each commit adds the population change of every
+// changed word to the counts above it, so the pyramid costs
+// nothing while the board is quiet and a whole block of any
+// size is counted with a single lookup. The state hash is
+// kept up to date the same way, from the changed words.
+//
+// On bounded grids, a step can instead cover a block of k
+// generations at once. The grid is cut into tiles, and each
+// tile is copied along with a k-tile border into scratch
+// space small enough to stay in cache, advanced k times
+// there, and written back, so a step reads and writes the
+// whole grid once rather than k times. Neighboring tiles
+// recompute each other's borders, and the change map then
+// records the words that differ across the whole block.
+///////////////////////////////////////////////////////////
+class GridEngine : public Engine {
+
+    // The visible generation, and the buffer the next one is
+    // computed into
+    Grid       *prev;
+    Grid       *next;
+
+    // The words that changed between the generation before `prev`
+    // and `prev`, the words that changed between `prev` and `next`,
+    // and scratch space for the dilation of `changed`
+    Grid       *changed;
+    Grid       *changed_next;
+    Grid       *dirty;
+
+    // The rule used for the last step, and the number of generations it
+    // covered. Changing either invalidates the change map, so everything
+    // is recomputed.
+    int         last_rule;
+    int         last_block;
+
+    Topology    topology;
+
+    // The number of generations each step covers
+    int         time_block;
+
+    // The live tiles of every aligned square of the visible generation
+    PopulationPyramid pyramid;
+
+    // The number of tiles that changed in the last committed step
+    int64_t     changed_count;
+
+    // The hash of the visible generation
+    uint64_t    hash;
+
+    // Threads reused for every generation
+    WorkerPool  pool;
+
+    uint64_t    generation;
+
+    // desc : Counts every block of the population pyramid, and hashes
+    //        the visible generation, from scratch
+    // pre  : None
+    // post : None, aside from description
+    void build_pyramid();
+
+    // desc : Adds the population change of every word flagged in
+    //        `changed` between `next` and `prev` to the pyramid, counts
+    //        the tiles that changed into `changed_count`, and updates
+    //        `hash` for the changed words
+    // pre  : `prev` must hold the generation after `next`, and `changed`
+    //        the words that differ between them
+    // post : None, aside from description
+    void update_pyramid();
+
+    // desc : Computes the generation `time_block` generations after `prev`
+    //        into `next` a tile at a time, flagging the words that differ
+    //        between the two in `changed_next`
+    // pre  : The grid must be bounded, and any step computed previously
+    //        must have been committed
+    // post : None, aside from description
+    void step_blocked(int rule);
+
+    // desc : Computes one tile of `step_blocked`: the `words` words of
+    //        rows [y,y+rows) starting at word `w`. Tiles are skipped when
+    //        `reuse` is set and the change map shows the area within
+    //        `time_block` tiles of them didn't change over the last step.
+    // pre  : Same as `step_blocked`, and `time_block` must be at most 64
+    // post : None, aside from description
+    void step_tile(int w, int y, int words, int rows, int rule, bool reuse);
+
+    public:
+
+    // desc : Creates an engine evolving the input grid, taking ownership
+    //        of it, and taking it to be generation `generation` of the
+    //        pattern. The grid's edges connect as `topology` says, and
+    //        each step covers `time_block` generations.
+    // pre  : `grid` must have been allocated with `new`, and `time_block`
+    //        must be in the range [1,64], and 1 unless the grid is bounded
+    // post : None, aside from description
+    GridEngine(Grid *grid, uint64_t generation = 0, Topology topology = Topology::bounded,
+               int time_block = 1);
+
+    // desc : Frees both grids
+    // pre  : None
+    // post : None, aside from description
+    ~GridEngine();
+
+    void        step(int rule) override;
+    void        commit() override;
+    bool        get_tile(int64_t x, int64_t y) override;
+    int64_t     get_width() override;
+    int64_t     get_height() override;
+    uint64_t    population() override;
+    uint64_t    get_generation() override;
+    std::string describe() override;
+    Grid       *snapshot() override;
+    bool        stays_in_bounds() override;
+    double      density(int64_t x, int64_t y, int64_t scale) override;
+    bool        area_changed(int64_t x, int64_t y, int64_t width, int64_t height) override;
+    int64_t     changed_tiles() override;
+    WorkerPool *get_pool() override;
+    bool        state_hash(uint64_t &hash) override;
+};
+
+#endif //ENGINE
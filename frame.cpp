@@ -0,0 +1,174 @@
+#include <algorithm>
+#include "frame.h"
+
+// desc : Initializes the frame as an empty view of generation 0
+// pre  : None
+// post : None, aside from description
+Frame::Frame()
+    : x(0)
+    , y(0)
+    , zoom(0)
+    , width(0)
+    , height(0)
+    , generation(0)
+    , sequence(0)
+{}
+
+// desc : Returns true if the frame covers the same cells at the same
+//        zoom as `other`, whatever generation either was taken from
+// pre  : None
+// post : None, aside from description
+bool Frame::same_view(Frame const &other) const {
+    return (x == other.x) && (y == other.y) && (zoom == other.zoom)
+        && (width == other.width) && (height == other.height);
+}
+
+// desc : Fills the pixels from the visible state of `engine`, reading
+//        single tiles at zoom 0 and densities otherwise, and leaving
+//        those past `limit_x` across or `limit_y` down dead. Each row is
+//        compared with the same row of `previous` to mark it, and is
+//        copied from it instead of sampled if the engine reports that
+//        none of the cells it covers changed.
+// pre  : The caller must keep `commit` from running concurrently.
+//        `previous`, if not null, must have been sampled from the state
+//        committed just before the visible one.
+// post : None, aside from description
+void Frame::sample(Engine &engine, int64_t limit_x, int64_t limit_y, Frame const *previous) {
+    int64_t scale = int64_t(1) << zoom;
+    generation = engine.get_generation();
+    pixels.resize(width * height);
+    dirty.assign(height, 1);
+
+    bool comparable = (previous != nullptr) && same_view(*previous)
+                   && (previous->pixels.size() == pixels.size());
+    for (int64_t py = 0; py < height; py++) {
+        float       *row = pixels.data() + py * width;
+        float const *old = comparable ? previous->pixels.data() + py * width : nullptr;
+        if (comparable && !engine.area_changed(x, y + py * scale, width * scale, scale)) {
+            std::copy(old, old + width, row);
+            dirty[py] = 0;
+            continue;
+        }
+        for (int64_t px = 0; px < width; px++) {
+            if ((px >= limit_x) || (py >= limit_y)) {
+                row[px] = 0;
+            } else if (scale == 1) {
+                row[px] = engine.get_tile(x + px, y + py);
+            } else {
+                row[px] = engine.density(x + px * scale, y + py * scale, scale);
+            }
+        }
+        dirty[py] = !comparable || !std::equal(row, row + width, old);
+    }
+}
+
+// desc : Compares every row with the same row of `previous`, marking
+//        them all if the two frames show different views
+// pre  : None
+// post : None, aside from description
+void Frame::mark(Frame const *previous) {
+    dirty.assign(height, 1);
+    if ((previous == nullptr) || !same_view(*previous)
+        || (previous->pixels.size() != pixels.size())) {
+        return;
+    }
+    for (int64_t py = 0; py < height; py++) {
+        float const *row = pixels.data() + py * width;
+        float const *old = previous->pixels.data() + py * width;
+        dirty[py] = !std::equal(row, row + width, old);
+    }
+}
+
+// desc : Returns the pixel at the input offset from the top-left corner
+//        of the view, or 0 past its edges
+// pre  : None
+// post : None, aside from description
+float Frame::operator()(int64_t px, int64_t py) const {
+    if ((px < 0) || (px >= width) || (py < 0) || (py >= height)) {
+        return 0;
+    }
+    return pixels[py * width + px];
+}
+
+
+// desc : Initializes all three frames as empty
+// pre  : None
+// post : None, aside from description
+FrameExchange::FrameExchange()
+    : back(0)
+    , latest(1)
+    , front(2)
+    , last(-1)
+    , published(0)
+    , dropped(0)
+    , repeated(0)
+{}
+
+// desc : Returns the frame the producer should fill next
+// pre  : Must only be called by the producer
+// post : None, aside from description
+Frame &FrameExchange::writing() {
+    return frames[back];
+}
+
+// desc : Returns the frame the producer published last, or null if it
+//        has never published a frame
+// pre  : Must only be called by the producer
+// post : None, aside from description
+Frame const *FrameExchange::last_published() {
+    return (last < 0) ? nullptr : &frames[last];
+}
+
+// desc : Numbers the written frame and swaps it in as the latest one,
+//        counting the frame it replaces as dropped if the consumer never
+//        took it
+// pre  : Must only be called by the producer
+// post : None, aside from description
+void FrameExchange::publish() {
+    frames[back].sequence = published.load(std::memory_order_relaxed) + 1;
+    last = back;
+    // Release the written pixels to the consumer, and acquire the frame
+    // it last gave back so that its reads finish before ours begin
+    int previous = latest.exchange(back | fresh, std::memory_order_acq_rel);
+    if (previous & fresh) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    back = previous & ~fresh;
+    published.fetch_add(1, std::memory_order_relaxed);
+}
+
+// desc : Takes the latest frame if it has been published since the last
+//        call, giving back the frame read until now, and returns it
+// pre  : Must only be called by the consumer
+// post : None, aside from description
+Frame const &FrameExchange::reading() {
+    if (latest.load(std::memory_order_relaxed) & fresh) {
+        front = latest.exchange(front, std::memory_order_acq_rel) & ~fresh;
+    } else {
+        repeated.fetch_add(1, std::memory_order_relaxed);
+    }
+    return frames[front];
+}
+
+// desc : Returns the number of frames published
+// pre  : None
+// post : None, aside from description
+uint64_t FrameExchange::get_published() {
+    return published.load(std::memory_order_relaxed);
+}
+
+// desc : Returns the number of published frames that the consumer never
+//        read, because a newer one replaced them first
+// pre  : None
+// post : None, aside from description
+uint64_t FrameExchange::get_dropped() {
+    return dropped.load(std::memory_order_relaxed);
+}
+
+// desc : Returns the number of times the consumer read a frame it had
+//        already read, because nothing newer had been published
+// pre  : None
+// post : None, aside from description
+uint64_t FrameExchange::get_repeated() {
+    return repeated.load(std::memory_order_relaxed);
+}
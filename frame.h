@@ -0,0 +1,177 @@
+#ifndef FRAME
+#define FRAME
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "engine.h"
+
+///////////////////////////////////////////////////////////
+// The pixels of one view of one generation, ready to be
+// drawn without touching the engine again. Each pixel holds
+// the fraction of live cells in the 2^zoom by 2^zoom square
+// of cells it covers.
+//
+// Frames also record which of their rows differ from the
+// frame published just before them, so that a reader who
+// drew that frame only needs to redraw those rows. Rows the
+// engine reports as unchanged are copied from the previous
+// frame rather than sampled again.
+///////////////////////////////////////////////////////////
+struct Frame {
+
+    // The cell at the top-left corner of the view, and the power of
+    // two cells across each pixel
+    int64_t              x;
+    int64_t              y;
+    int                  zoom;
+
+    // The dimensions of the view, in pixels
+    int64_t              width;
+    int64_t              height;
+
+    // The generation the pixels were taken from
+    uint64_t             generation;
+
+    // The position of the frame in the order frames were published,
+    // counting from 1, or 0 if it was never published
+    uint64_t             sequence;
+
+    // The pixels, stored row by row
+    std::vector<float>   pixels;
+
+    // For each row, whether it differs from the same row of the frame
+    // published just before this one
+    std::vector<uint8_t> dirty;
+
+    // desc : Initializes the frame as an empty view of generation 0
+    // pre  : None
+    // post : None, aside from description
+    Frame();
+
+    // desc : Returns true if the frame covers the same cells at the same
+    //        zoom as `other`, whatever generation either was taken from
+    // pre  : None
+    // post : None, aside from description
+    bool same_view(Frame const &other) const;
+
+    // desc : Fills the pixels from the visible state of `engine`, leaving
+    //        those past `limit_x` across or `limit_y` down dead, and marks
+    //        the rows that differ from `previous`. If `previous` shows the
+    //        same view, rows the engine reports as unchanged are copied
+    //        from it. Without one, every row is marked.
+    // pre  : The caller must keep `commit` from running concurrently.
+    //        `previous`, if not null, must have been sampled from the
+    //        state committed just before the visible one.
+    // post : None, aside from description
+    void sample(Engine &engine, int64_t limit_x, int64_t limit_y, Frame const *previous = nullptr);
+
+    // desc : Marks the rows whose pixels differ from the same row of
+    //        `previous`, or every row if there is no previous frame or it
+    //        shows another view, for frames whose pixels were not sampled
+    //        against the frame published before them
+    // pre  : None
+    // post : None, aside from description
+    void mark(Frame const *previous);
+
+    // desc : Returns the pixel at the input offset from the top-left
+    //        corner of the view, or 0 past its edges
+    // pre  : None
+    // post : None, aside from description
+    float operator()(int64_t px, int64_t py) const;
+};
+
+
+
+
+///////////////////////////////////////////////////////////
+// Hands frames from one producer thread to one consumer
+// thread without either ever waiting on the other.
+//
+// Three frames rotate between the roles of the one being
+// written, the latest one published, and the one being read.
+// Publishing swaps the written frame with the latest one,
+// and reading swaps the latest one with the one being read
+// if it has been published since, each with a single atomic
+// exchange. The producer never blocks however slow the
+// consumer is, and the consumer always reads the newest
+// complete frame.
+///////////////////////////////////////////////////////////
+class FrameExchange {
+
+    // Set in `latest` when the frame it points to has been published
+    // but not yet taken by the consumer
+    static const int fresh = 4;
+
+    Frame            frames[3];
+
+    // The index of the frame being written, which only the producer
+    // touches, the frame last published, and the frame being read,
+    // which only the consumer touches
+    int              back;
+    std::atomic<int> latest;
+    int              front;
+
+    // The index of the frame the producer published last, or -1 before
+    // the first publish. Whichever role that frame is in, nothing
+    // writes to it until the producer publishes again.
+    int              last;
+
+    // The number of frames published, the number replaced by a newer
+    // one before the consumer took them, and the number of times the
+    // consumer found nothing new and reused the frame it had
+    std::atomic<uint64_t> published;
+    std::atomic<uint64_t> dropped;
+    std::atomic<uint64_t> repeated;
+
+    public:
+
+    // desc : Initializes all three frames as empty
+    // pre  : None
+    // post : None, aside from description
+    FrameExchange();
+
+    // desc : Returns the frame the producer should fill next
+    // pre  : Must only be called by the producer
+    // post : None, aside from description
+    Frame &writing();
+
+    // desc : Returns the frame the producer published last, which it may
+    //        read while filling the next one, or null if it has never
+    //        published a frame
+    // pre  : Must only be called by the producer
+    // post : None, aside from description
+    Frame const *last_published();
+
+    // desc : Makes the frame returned by `writing` the latest one, gives
+    //        it the next sequence number, and hands the producer a
+    //        different frame to fill next
+    // pre  : Must only be called by the producer
+    // post : None, aside from description
+    void publish();
+
+    // desc : Returns the newest published frame, which stays untouched by
+    //        the producer until the next call to `reading`
+    // pre  : Must only be called by the consumer
+    // post : None, aside from description
+    Frame const &reading();
+
+    // desc : Returns the number of frames published
+    // pre  : None
+    // post : None, aside from description
+    uint64_t get_published();
+
+    // desc : Returns the number of published frames that the consumer
+    //        never read, because a newer one replaced them first
+    // pre  : None
+    // post : None, aside from description
+    uint64_t get_dropped();
+
+    // desc : Returns the number of times the consumer read a frame it
+    //        had already read, because nothing newer had been published
+    // pre  : None
+    // post : None, aside from description
+    uint64_t get_repeated();
+};
+
+#endif //FRAME
@@ -1,6 +1,21 @@
+#include <algorithm>
+#include <cstring>
 #include <iostream>
-#include "grid.h"
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
+#include "grid.h"
+#include "kernel.h"
+
+// desc : Returns a pointer to the first word of the input row
+// pre  : `y` must be in the range [-1,height], where -1 and height
+//        refer to the padding rows
+// post : None, aside from description
+uint64_t *Grid::row(int y) {
+    return buffer + (y+1) * stride + 1;
+}
 
 // desc : Reports whether or not the input coordinates correspond
 //        to a valid position in the grid
@@ -17,11 +32,10 @@ bool Grid::exists(int x, int y){
 
 // desc : Returns whether or not the cell/tile at the input coordinates
 //        is alive.
-// pre  : Coordinates must be valid for the grid
+// pre  : Coordinates must be valid for the grid, or name a ghost tile
 // post : None, aside from description
 bool Grid::get_tile(int x, int y) {
-    int index = (width+1) * y + x;
-    return buffer[index];
+    return (row(y)[x >> 6] >> (x & 63)) & 1;
 }
 
 // desc : Sets whether or not the cell/tile at the input coordinates
@@ -29,8 +43,29 @@ bool Grid::get_tile(int x, int y) {
 // pre  : Coordinates must be valid for the grid
 // post : None, aside from description
 void Grid::set_tile(int x, int y, bool value){
-    int index = (width+1) * y + x;
-    buffer[index] = value;
+    uint64_t &word = row(y)[x >> 6];
+    uint64_t  mask = uint64_t(1) << (x & 63);
+    word = value ? (word | mask) : (word & ~mask);
+}
+
+// desc : Returns the number of live tiles in the grid
+// pre  : None
+// post : None, aside from description
+uint64_t Grid::population(){
+    // The last word of a row may hold a ghost tile past its end
+    int      tail      = width & 63;
+    uint64_t tail_mask = (tail == 0) ? ~uint64_t(0) : (uint64_t(1) << tail) - 1;
+    uint64_t total = 0;
+    for(int y=0; y<height; y++){
+        uint64_t *words_y = row(y);
+        for(int w=0; w<words-1; w++){
+            total += __builtin_popcountll(words_y[w]);
+        }
+        if( words > 0 ){
+            total += __builtin_popcountll(words_y[words-1] & tail_mask);
+        }
+    }
+    return total;
 }
 
 // desc : Returns grid width
@@ -50,42 +85,206 @@ int Grid::get_height(){
 // desc : Overwrites the state of the tile identified by the input
 //        coordinates, following the rules of Conway's Game of Life and
 //        using the input grid (other) as the state of the preceding
-//        generation.
-// pre  : Coordinates must be valid for the grid
+//        generation. Neighbors past the edges are read from the ghost
+//        tiles of `other`.
+// pre  : Coordinates must be valid for the grid, and the ghost tiles
+//        of `other` must have been filled
 // post : None, aside from description
 void Grid::update_tile(Grid& other, int x, int y, int rule){
-    // Intentional delay
-    usleep(100);
-
     // Check if cell was alive in previous state
     bool alive = other.get_tile(x,y);
 
-    // For each cell in the 3x3 grid centered on the
-    // input coordinates in the input Grid 'other'...
-    int count  = 0;
+    // Sum the 3x3 grid centered on the input coordinates in the input
+    // Grid 'other', then take away the cell exactly at (x,y). Neighbors
+    // past the edges are ghost tiles, so no coordinate needs checking.
+    int count  = -alive;
     for(int i=-1; i<=1; i++){
         for(int j=-1; j<=1; j++){
-            // ... do nothing for the cell exactly
-            // at (x,y)
-            if( (i==0) && (j==0) ){
-                continue;
-            }
+            count += other.get_tile(x+i,y+j);
+        }
+    }
+
+    bool end_state = (rule>>((alive*9)+count)) & 1;
+    set_tile(x,y,end_state);
+}
+
+// desc : Overwrites every tile of the input row with its next state,
+//        using the input grid (other) as the state of the preceding
+//        generation. Produces the same result as calling `update_tile`
+//        on every tile of the row, but advances 64 tiles at a time.
+// pre  : `other` must have the same dimensions as this grid, and `y`
+//        must be a valid row for the grid
+// post : None, aside from description
+void Grid::update_row(Grid& other, int y, int rule){
+    uint64_t *out = row(y);
+    step_row(other.row(y-1), other.row(y), other.row(y+1), out, words, rule);
 
-            // Add one to the count if adjacent
-            // cells are alive
-            int query_x = x+i;
-            int query_y = y+j;
-            if( !other.exists(query_x,query_y)){
-                continue;
+    // Tiles past the right edge of the grid must stay dead, even under
+    // rules where dead tiles with no neighbors are born
+    int tail = width & 63;
+    if (tail != 0) {
+        out[words-1] &= (uint64_t(1) << tail) - 1;
+    }
+}
+
+// desc : Overwrites only the words of the input row flagged in `dirty`
+//        with their next state, using the input grid (other) as the
+//        state of the preceding generation. Bit i of dirty[j] flags
+//        word 64*j+i of the row. The flags of the updated words that
+//        now differ from `other` are written to `changed`, laid out the
+//        same way, and all other flags are cleared.
+// pre  : `other` must have the same dimensions as this grid, `y`
+//        must be a valid row for the grid, and `dirty` and `changed`
+//        must each hold one bit per word of the row
+// post : None, aside from description
+void Grid::update_words(Grid& other, int y, uint64_t const *dirty,
+                        uint64_t *changed, int rule){
+    uint64_t *out    = row(y);
+    uint64_t *before = other.row(y);
+    int tail = width & 63;
+    uint64_t tail_mask = (tail == 0) ? ~uint64_t(0) : (uint64_t(1) << tail) - 1;
+    int flag_words = (words+63)/64;
+
+    for(int j=0; j<flag_words; j++){
+        uint64_t flags = dirty[j];
+        uint64_t diffs = 0;
+        while(flags != 0){
+            // Step each run of consecutive flagged words in one go
+            int      start = __builtin_ctzll(flags);
+            uint64_t run   = ~(flags >> start);
+            int      count = (run == 0) ? 64 : __builtin_ctzll(run);
+            int      first = 64*j + start;
+            step_row(other.row(y-1)+first, before+first, other.row(y+1)+first,
+                     out+first, count, rule);
+            if( (tail != 0) && (first+count == words) ){
+                out[words-1] &= (uint64_t(1) << tail) - 1;
             }
-            if( other.get_tile(query_x,query_y) ){
-                count += 1;
+            for(int i=0; i<count; i++){
+                // Ignore a ghost tile past the end of the row
+                uint64_t diff = out[first+i] ^ before[first+i];
+                if( first+i == words-1 ){
+                    diff &= tail_mask;
+                }
+                if( diff != 0 ){
+                    diffs |= uint64_t(1) << (start+i);
+                }
             }
+            flags = (count == 64) ? 0 : flags & ~(((uint64_t(1) << count) - 1) << start);
         }
+        changed[j] = diffs;
     }
+}
 
-    bool end_state = (rule>>((alive*9)+count)) & 1;
-    set_tile(x,y,end_state);
+// desc : Returns the input word with the order of its bits reversed
+// pre  : None
+// post : None, aside from description
+static uint64_t reverse_bits(uint64_t x){
+    x = ((x >> 1) & 0x5555555555555555ull) | ((x & 0x5555555555555555ull) << 1);
+    x = ((x >> 2) & 0x3333333333333333ull) | ((x & 0x3333333333333333ull) << 2);
+    x = ((x >> 4) & 0x0F0F0F0F0F0F0F0Full) | ((x & 0x0F0F0F0F0F0F0F0Full) << 4);
+    return __builtin_bswap64(x);
+}
+
+// desc : Sets every ghost tile around the grid to the tile it stands
+//        for under the input topology, or to dead if the grid is bounded
+// pre  : None
+// post : None, aside from description
+void Grid::fill_ghosts(Topology topology){
+    int      tail      = width & 63;
+    uint64_t tail_mask = (tail == 0) ? ~uint64_t(0) : (uint64_t(1) << tail) - 1;
+
+    // Words are only written when their value changes, so that a grid
+    // mapped from a checkpoint, whose ghost tiles are already right,
+    // keeps sharing its pages with the file
+    auto store = [](uint64_t &word, uint64_t value){
+        if( word != value ){
+            word = value;
+        }
+    };
+
+    // Sets the ghost tiles of a row to dead or, unless the grid is
+    // bounded, to the tiles across its opposite edge
+    auto fill_columns = [&](uint64_t *words_y){
+        bool     wrap = (topology != Topology::bounded) && (width > 0);
+        uint64_t west = wrap ? ((words_y[(width-1) >> 6] >> ((width-1) & 63)) & 1) << 63 : 0;
+        uint64_t east = wrap ? (words_y[0] & 1) : 0;
+        store(words_y[-1], west);
+        if( tail != 0 ){
+            store(words_y[words-1], (words_y[words-1] & tail_mask) | (east << tail));
+            store(words_y[words], 0);
+        } else {
+            store(words_y[words], east);
+        }
+    };
+
+    for(int y=0; y<height; y++){
+        fill_columns(row(y));
+    }
+
+    uint64_t *above = row(-1) - 1;
+    uint64_t *below = row(height) - 1;
+    if( (topology == Topology::bounded) || (height == 0) ){
+        for(int i=0; i<stride; i++){
+            store(above[i], 0);
+            store(below[i], 0);
+        }
+    } else if( topology == Topology::torus ){
+        std::copy(row(height-1)-1, row(height-1)-1+stride, above);
+        std::copy(row(0)-1,        row(0)-1+stride,        below);
+    } else {
+        // Tile x of a mirrored row is tile width-1-x of its source.
+        // Reversing the words and the bits within them mirrors the row
+        // about 64*words, so the result is shifted down by the unused
+        // bits of the last word to line it back up.
+        int shift = (64 - tail) & 63;
+        auto mirror = [&](uint64_t const *src, uint64_t *dst){
+            for(int i=0; i<words; i++){
+                uint64_t low  = reverse_bits(src[words-1-i]);
+                uint64_t high = (i+1 < words) ? reverse_bits(src[words-2-i]) : 0;
+                dst[i] = (shift == 0) ? low : (low >> shift) | (high << (64-shift));
+            }
+            fill_columns(dst);
+        };
+        mirror(row(height-1), row(-1));
+        mirror(row(0),        row(height));
+    }
+}
+
+// desc : Sets every tile of the grid to the input state
+// pre  : None
+// post : None, aside from description
+void Grid::fill(bool value){
+    int tail = width & 63;
+    for(int y=0; y<height; y++){
+        uint64_t *words_y = row(y);
+        for(int w=0; w<words; w++){
+            words_y[w] = value ? ~uint64_t(0) : 0;
+        }
+        if( value && (tail != 0) ){
+            words_y[words-1] &= (uint64_t(1) << tail) - 1;
+        }
+    }
+}
+
+// desc : Returns a pointer to the grid's whole buffer, padding included
+// pre  : None
+// post : None, aside from description
+uint64_t const *Grid::get_buffer(){
+    return buffer;
+}
+
+// desc : Returns the number of words in the grid's buffer
+// pre  : None
+// post : None, aside from description
+size_t Grid::get_buffer_words(){
+    return (size_t) stride * (height+2);
+}
+
+// desc : Returns the number of words holding the tiles of each row
+// pre  : None
+// post : None, aside from description
+int Grid::get_words(){
+    return words;
 }
 
 // desc : Creates a grid with dimensions matching the input height and
@@ -95,67 +294,156 @@ void Grid::update_tile(Grid& other, int x, int y, int rule){
 Grid::Grid(int w, int h)
     : height(h)
     , width(w)
+    , words((w+63)/64)
+    , stride(words+2)
+    , mapping(nullptr)
+    , mapping_size(0)
 {
-    buffer = new bool[(width+1)*height];
-    for(int i=0; i<height; i++){
-        for(int j=0; j<width; j++){
-            set_tile(j,i,false);
+    buffer = new uint64_t[(size_t) stride * (height+2)]();
+}
+
+// desc : Creates a grid whose buffer, padding included, is the memory
+//        `offset` bytes into the input mapping, adopting the mapping
+//        rather than copying it
+// pre  : The mapping must come from a writable `mmap` large
+//        enough to hold a `w` by `h` grid at `offset`, which must be a
+//        multiple of 8
+// post : None, aside from description
+Grid::Grid(int w, int h, void *mapping, size_t mapping_size, size_t offset)
+    : height(h)
+    , width(w)
+    , words((w+63)/64)
+    , stride(words+2)
+    , buffer((uint64_t *) ((char *) mapping + offset))
+    , mapping(mapping)
+    , mapping_size(mapping_size)
+{}
+
+// desc : Creates a grid with the same dimensions and tiles as `other`
+// pre  : None
+// post : None, aside from description
+Grid::Grid(Grid const &other)
+    : height(other.height)
+    , width(other.width)
+    , words(other.words)
+    , stride(other.stride)
+    , mapping(nullptr)
+    , mapping_size(0)
+{
+    size_t count = (size_t) stride * (height+2);
+    buffer = new uint64_t[count];
+    std::copy(other.buffer, other.buffer + count, buffer);
+}
+
+// desc : Packs `length` characters into tile words, appending them to
+//        `packed`, with spaces as dead tiles and anything else as live
+//        tiles. Eight characters are classified at a time by treating
+//        them as the bytes of one word.
+// pre  : None
+// post : None, aside from description
+static void pack_line(char const *line, size_t length, std::vector<uint64_t> &packed){
+    const uint64_t spaces = 0x2020202020202020ull;
+    const uint64_t low7   = 0x7F7F7F7F7F7F7F7Full;
+    const uint64_t highs  = 0x8080808080808080ull;
+    // Multiplying by this gathers bit 0 of byte i into bit 56+i
+    const uint64_t gather = 0x0102040810204080ull;
+
+    for(size_t start=0; start<length; start+=64){
+        size_t   chunk = std::min<size_t>(64, length-start);
+        uint64_t word  = 0;
+        size_t   i     = 0;
+        for(; i+8<=chunk; i+=8){
+            uint64_t bytes;
+            std::memcpy(&bytes, line+start+i, 8);
+            // Spaces become zero bytes, then every non-zero byte gets
+            // its high bit set
+            uint64_t x = bytes ^ spaces;
+            uint64_t t = (((x & low7) + low7) | x) & highs;
+            word |= (((t >> 7) * gather) >> 56) << i;
         }
-    }
-    for(int i=0; i<height; i++){
-        buffer[(width+1)*i+width] = '\n';
+        for(; i<chunk; i++){
+            word |= uint64_t(line[start+i] != ' ') << i;
+        }
+        packed.push_back(word);
     }
 }
 
 // desc : Creates a grid with dimensions and tile states matching the
 //        content of the input file, with each line interpreted as a row
-//        and all non-space characters counted as 'alive'.
-// pre  : `file_path` must correspond to a valid file
-// post : None, aside from description
+//        and all non-space characters counted as 'alive'. The file is
+//        memory-mapped and scanned once, packing each line as soon as
+//        its end is found.
+// pre  : None
+// post : Throws a std::runtime_error if the file can't be read
 Grid::Grid(std::string file_path)
+    : mapping(nullptr)
+    , mapping_size(0)
 {
-    std::ifstream file;
-    file.open(file_path);
+    int fd = open(file_path.c_str(), O_RDONLY);
+    if( fd < 0 ){
+        throw std::runtime_error("Cannot open file");
+    }
+    struct stat info;
+    if( fstat(fd, &info) != 0 ){
+        close(fd);
+        throw std::runtime_error("Cannot read file");
+    }
+    size_t size = info.st_size;
+    char const *data = nullptr;
+    if( size != 0 ){
+        void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if( mapping == MAP_FAILED ){
+            close(fd);
+            throw std::runtime_error("Cannot map file");
+        }
+        madvise(mapping, size, MADV_SEQUENTIAL);
+        data = (char const *) mapping;
+    }
+    close(fd);
+
+    // The width isn't known until every line has been seen, so lines are
+    // packed into a scratch buffer as they are found, recording where
+    // each one starts, and only copied into place at the end
+    std::vector<uint64_t> packed;
+    std::vector<size_t>   starts;
     width  = 0;
     height = 0;
-    std::string line;
-
-    // Determine height by the number of lines
-    // Determine width  by the maximum line width
-    while(std::getline(file,line)){
-        int line_size = line.size();
-        width = (width>line_size) ? width : line.size();
+    char const *cursor = data;
+    char const *end    = data + size;
+    while( cursor < end ){
+        char const *newline  = (char const *) std::memchr(cursor, '\n', end-cursor);
+        char const *line_end = newline ? newline : end;
+        int line_size = line_end - cursor;
+        starts.push_back(packed.size());
+        pack_line(cursor, line_size, packed);
+        width = std::max(width, line_size);
         height++;
+        cursor = newline ? newline+1 : end;
     }
+    starts.push_back(packed.size());
 
-    // Allocate character buffer to store tile data
-    buffer = new bool[(width+1)*height];
-
-    // Reset position in the file to the start
-    file.clear();
-    file.seekg(0,std::ios::beg);
+    if( data != nullptr ){
+        munmap((void *) data, size);
+    }
 
-    // Initialize each row based off of each line in
-    // the file
-    int y = 0;
-    while(std::getline(file,line)){
-        for(int x=0; x<width; x++){
-            bool val = false;
-            int line_size = line.size();
-            if( x<line_size ){
-                val = line[x] != ' ';
-            }
-            this->set_tile(x,y,val);
-        }
-        buffer[(width+1)*y+width] = '\n';
-        y++;
+    // Allocate zeroed word buffer to store tile data, then copy in
+    // each packed line, leaving the words past its end dead
+    words  = (width+63)/64;
+    stride = words+2;
+    buffer = new uint64_t[(size_t) stride * (height+2)]();
+    for(int y=0; y<height; y++){
+        std::copy(packed.begin()+starts[y], packed.begin()+starts[y+1], row(y));
     }
 }
 
-// desc : Frees the grid's buffer
+// desc : Frees the grid's buffer, or unmaps it if it was adopted from
+//        a file mapping
 // pre  : None
 // post : None, aside from description
 Grid::~Grid(){
-    delete[] buffer;
+    if( mapping != nullptr ){
+        munmap(mapping, mapping_size);
+    } else {
+        delete[] buffer;
+    }
 }
-
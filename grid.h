@@ -1,21 +1,56 @@
 #ifndef GRID
 #define GRID
 
+#include <cstdint>
 #include <fstream>
 #include <vector>
 #include "tui.h"
 
+// How the edges of a grid connect. Bounded grids are surrounded by dead
+// tiles. A torus wraps both pairs of edges around, and a Klein bottle
+// wraps the left and right edges but mirrors the grid horizontally when
+// wrapping between the top and bottom edges.
+enum class Topology { bounded, torus, klein };
+
 ///////////////////////////////////////////////////////////
 // Represents a grid of tiles in Conways Game of Life.
+//
+// Tiles are bit-packed, 64 per word, with bit `i` of word `w`
+// in a row holding the tile at x = 64*w + i. Each row is
+// bordered by a padding word on both sides, and the grid is
+// bordered by a padding row above and below, so that the
+// stepping kernel can read the neighbors of any tile without
+// checking coordinates.
+//
+// The tiles just outside the grid (x = -1 and x = width, or
+// y = -1 and y = height) are ghost tiles, stored in the
+// padding and, for x = width, possibly in the unused high bits
+// of a row's last word. `fill_ghosts` sets them from the
+// grid's edges to match a topology. All other padding, and
+// the ghost tiles of a bounded grid, are dead.
 ///////////////////////////////////////////////////////////
 class Grid {
 
-    int   height;
-    int   width;
-    bool *buffer;
+    int       height;
+    int       width;
+    // The number of words holding the tiles of a single row
+    int       words;
+    // The distance, in words, between the starts of adjacent rows
+    int       stride;
+    uint64_t *buffer;
+    // The file mapping holding `buffer`, if the grid was loaded from a
+    // checkpoint rather than allocated, and its size in bytes
+    void     *mapping;
+    size_t    mapping_size;
 
     public:
 
+    // desc : Returns a pointer to the first word of the input row
+    // pre  : `y` must be in the range [-1,height], where -1 and height
+    //        refer to the padding rows
+    // post : None, aside from description
+    uint64_t *row(int y);
+
     // desc : Reports whether or not the input coordinates correspond
     //        to a valid position in the grid
     // pre  : None
@@ -33,18 +68,77 @@ class Grid {
 
     // desc : Returns whether or not the cell/tile at the input coordinates
     //        is alive.
-    // pre  : Coordinates must be valid for the grid
+    // pre  : Coordinates must be valid for the grid, or name a ghost tile
     // post : None, aside from description
     bool get_tile(int x, int y);
 
     // desc : Overwrites the state of the tile identified by the input
     //        coordinates, following the rules of Conway's Game of Life and
     //        using the input grid (other) as the state of the preceding
-    //        generation.
-    // pre  : Coordinates must be valid for the grid
+    //        generation. Neighbors past the edges are read from the ghost
+    //        tiles of `other`.
+    // pre  : Coordinates must be valid for the grid, and the ghost tiles
+    //        of `other` must have been filled
     // post : None, aside from description
     void update_tile(Grid& other, int x, int y, int rule);
 
+    // desc : Overwrites every tile of the input row with its next state,
+    //        using the input grid (other) as the state of the preceding
+    //        generation. Produces the same result as calling `update_tile`
+    //        on every tile of the row, but advances 64 tiles at a time.
+    // pre  : `other` must have the same dimensions as this grid, `y`
+    //        must be a valid row for the grid, and the ghost tiles of
+    //        `other` must have been filled
+    // post : None, aside from description
+    void update_row(Grid& other, int y, int rule);
+
+    // desc : Overwrites only the words of the input row flagged in `dirty`
+    //        with their next state, using the input grid (other) as the
+    //        state of the preceding generation. Bit i of dirty[j] flags
+    //        word 64*j+i of the row. The flags of the updated words that
+    //        now differ from `other` are written to `changed`, laid out the
+    //        same way, and all other flags are cleared.
+    // pre  : `other` must have the same dimensions as this grid, `y`
+    //        must be a valid row for the grid, `dirty` and `changed`
+    //        must each hold one bit per word of the row, and the ghost
+    //        tiles of `other` must have been filled
+    // post : None, aside from description
+    void update_words(Grid& other, int y, uint64_t const *dirty,
+                      uint64_t *changed, int rule);
+
+    // desc : Sets every ghost tile around the grid to the tile it stands
+    //        for under the input topology, or to dead if the grid is
+    //        bounded, so that stepping needs no special cases at the edges
+    // pre  : None
+    // post : None, aside from description
+    void fill_ghosts(Topology topology);
+
+    // desc : Sets every tile of the grid to the input state
+    // pre  : None
+    // post : None, aside from description
+    void fill(bool value);
+
+    // desc : Returns the number of words holding the tiles of each row
+    // pre  : None
+    // post : None, aside from description
+    int get_words();
+
+    // desc : Returns a pointer to the grid's whole buffer, padding
+    //        included, which holds `get_buffer_words()` words
+    // pre  : None
+    // post : None, aside from description
+    uint64_t const *get_buffer();
+
+    // desc : Returns the number of words in the grid's buffer
+    // pre  : None
+    // post : None, aside from description
+    size_t get_buffer_words();
+
+    // desc : Returns the number of live tiles in the grid
+    // pre  : None
+    // post : None, aside from description
+    uint64_t population();
+
     // desc : Returns grid width
     // pre  : None
     // post : None, aside from description
@@ -63,12 +157,37 @@ class Grid {
 
     // desc : Creates a grid with dimensions and tile states matching the
     //        content of the input file, with each line interpreted as a row
-    //        and all non-space characters counted as 'alive'.
-    // pre  : `file_path` must correspond to a valid file
-    // post : None, aside from description
+    //        and all non-space characters counted as 'alive'. The file is
+    //        memory-mapped and scanned once, packing each line as soon as
+    //        its end is found.
+    // pre  : None
+    // post : Throws a std::runtime_error if the file can't be read
     Grid(std::string file_path);
 
-    // desc : Frees the grid's buffer
+    // desc : Creates a grid whose buffer, padding included, is the memory
+    //        `offset` bytes into the input mapping, adopting the mapping
+    //        rather than copying it. Writes to the grid only touch the
+    //        process's private copy of the mapped pages, unless the
+    //        mapping is shared.
+    // pre  : The mapping must come from a writable `mmap` large
+    //        enough to hold a `w` by `h` grid at `offset`, which must be a
+    //        multiple of 8
+    // post : None, aside from description
+    Grid(int w, int h, void *mapping, size_t mapping_size, size_t offset);
+
+    // desc : Creates a grid with the same dimensions and tiles as `other`
+    // pre  : None
+    // post : None, aside from description
+    Grid(Grid const &other);
+
+    // desc : Not allowed, since grids own their buffer or mapping and
+    //        assigning one to another would leave both freeing it
+    // pre  : None
+    // post : None, aside from description
+    Grid &operator=(Grid const &other) = delete;
+
+    // desc : Frees the grid's buffer, or unmaps it if it was adopted
+    //        from a file mapping
     // pre  : None
     // post : None, aside from description
     ~Grid();
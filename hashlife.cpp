@@ -0,0 +1,477 @@
+#include <algorithm>
+#include "hashlife.h"
+
+// desc : Mixes the addresses of a node's quadrants into a hash
+// pre  : None
+// post : None, aside from description
+static uint64_t hash_quadrants(void *nw, void *ne, void *sw, void *se) {
+    uint64_t h = (uint64_t) nw;
+    h = h * 0x9E3779B97F4A7C15ull + (uint64_t) ne;
+    h = h * 0x9E3779B97F4A7C15ull + (uint64_t) sw;
+    h = h * 0x9E3779B97F4A7C15ull + (uint64_t) se;
+    h ^= h >> 29;
+    h *= 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 32;
+    return h;
+}
+
+// desc : Returns the canonical node with the input quadrants,
+//        creating it if it doesn't exist yet
+// pre  : All quadrants must share a level
+// post : None, aside from description
+HashLife::Node *HashLife::join(Node *nw, Node *ne, Node *sw, Node *se) {
+    size_t bucket = hash_quadrants(nw, ne, sw, se) & (table.size() - 1);
+    for (Node *node = table[bucket]; node != nullptr; node = node->next) {
+        if (   (node->nw == nw) && (node->ne == ne)
+            && (node->sw == sw) && (node->se == se)) {
+            return node;
+        }
+    }
+
+    Node *node = new Node {
+        nw, ne, sw, se,
+        table[bucket],
+        nullptr,
+        nw->population + ne->population + sw->population + se->population,
+        nw->level + 1,
+        false
+    };
+    table[bucket] = node;
+    node_count++;
+    if (node_count > table.size()) {
+        rehash();
+    }
+    return node;
+}
+
+// desc : Grows the hash table and redistributes its nodes
+// pre  : None
+// post : None, aside from description
+void HashLife::rehash() {
+    std::vector<Node*> old_table(table.size() * 2, nullptr);
+    std::swap(table, old_table);
+    for (Node *node : old_table) {
+        while (node != nullptr) {
+            Node  *next   = node->next;
+            size_t bucket = hash_quadrants(node->nw, node->ne, node->sw, node->se)
+                          & (table.size() - 1);
+            node->next    = table[bucket];
+            table[bucket] = node;
+            node = next;
+        }
+    }
+}
+
+// desc : Returns the canonical empty node of the input level
+// pre  : None
+// post : None, aside from description
+HashLife::Node *HashLife::empty(int level) {
+    if (level == 0) {
+        return leaves[0];
+    }
+    if ((int) empties.size() <= level) {
+        empties.resize(level + 1, nullptr);
+    }
+    if (empties[level] == nullptr) {
+        Node *quarter  = empty(level - 1);
+        empties[level] = join(quarter, quarter, quarter, quarter);
+    }
+    return empties[level];
+}
+
+// desc : Returns a node one level up, with the input node at its
+//        center and empty space around it
+// pre  : `node` must not be a leaf
+// post : None, aside from description
+HashLife::Node *HashLife::expand(Node *node) {
+    Node *e = empty(node->level - 1);
+    return join(
+        join(e, e, e, node->nw),
+        join(e, e, node->ne, e),
+        join(e, node->sw, e, e),
+        join(node->se, e, e, e)
+    );
+}
+
+// desc : Returns the center half of the input node, unstepped
+// pre  : `node` must be at least level 2
+// post : None, aside from description
+HashLife::Node *HashLife::center(Node *node) {
+    return join(node->nw->se, node->ne->sw, node->sw->ne, node->se->nw);
+}
+
+// desc : Computes the center 2x2 of a 4x4 node, one generation later
+// pre  : `node` must be level 2
+// post : None, aside from description
+HashLife::Node *HashLife::base_step(Node *node) {
+    // Unpack the 4x4 square into bits, indexed by (y*4+x)
+    Node *quadrants[4] = { node->nw, node->ne, node->sw, node->se };
+    int bits = 0;
+    for (int q=0; q<4; q++) {
+        int x = (q & 1) * 2;
+        int y = (q >> 1) * 2;
+        bits |= int(quadrants[q]->nw->population) << ( y   *4 + x  );
+        bits |= int(quadrants[q]->ne->population) << ( y   *4 + x+1);
+        bits |= int(quadrants[q]->sw->population) << ((y+1)*4 + x  );
+        bits |= int(quadrants[q]->se->population) << ((y+1)*4 + x+1);
+    }
+
+    // Apply the rule to each of the four center tiles
+    Node *next[4];
+    for (int q=0; q<4; q++) {
+        int x = 1 + (q & 1);
+        int y = 1 + (q >> 1);
+        int count = 0;
+        for (int j=-1; j<=1; j++) {
+            for (int i=-1; i<=1; i++) {
+                if ((i != 0) || (j != 0)) {
+                    count += (bits >> ((y+j)*4 + (x+i))) & 1;
+                }
+            }
+        }
+        bool alive = (bits >> (y*4 + x)) & 1;
+        next[q] = leaves[(rule >> ((alive*9)+count)) & 1];
+    }
+    return join(next[0], next[1], next[2], next[3]);
+}
+
+// desc : Returns the RESULT of the input node, computing and caching
+//        it if necessary
+// pre  : `node` must be at least level 2
+// post : None, aside from description
+HashLife::Node *HashLife::successor(Node *node) {
+    if (node->result != nullptr) {
+        return node->result;
+    }
+    if (node->population == 0) {
+        node->result = empty(node->level - 1);
+        return node->result;
+    }
+    if (node->level == 2) {
+        node->result = base_step(node);
+        return node->result;
+    }
+
+    // Split the node into nine overlapping squares, each half its size
+    Node *nw = node->nw;
+    Node *ne = node->ne;
+    Node *sw = node->sw;
+    Node *se = node->se;
+    Node *c00 = successor(nw);
+    Node *c01 = successor(join(nw->ne, ne->nw, nw->se, ne->sw));
+    Node *c02 = successor(ne);
+    Node *c10 = successor(join(nw->sw, nw->se, sw->nw, sw->ne));
+    Node *c11 = successor(join(nw->se, ne->sw, sw->ne, se->nw));
+    Node *c12 = successor(join(ne->sw, ne->se, se->nw, se->ne));
+    Node *c20 = successor(sw);
+    Node *c21 = successor(join(sw->ne, se->nw, sw->se, se->sw));
+    Node *c22 = successor(se);
+
+    if (step_exp < node->level - 2) {
+        // The nine squares have already advanced as far as a step
+        // allows, so just stitch their centers together
+        node->result = join(
+            join(c00->se, c01->sw, c10->ne, c11->nw),
+            join(c01->se, c02->sw, c11->ne, c12->nw),
+            join(c10->se, c11->sw, c20->ne, c21->nw),
+            join(c11->se, c12->sw, c21->ne, c22->nw)
+        );
+    } else {
+        // Advance the four overlapping quarters a second time
+        node->result = join(
+            successor(join(c00, c01, c10, c11)),
+            successor(join(c01, c02, c11, c12)),
+            successor(join(c10, c11, c20, c21)),
+            successor(join(c11, c12, c21, c22))
+        );
+    }
+    return node->result;
+}
+
+// desc : Builds the node of the input level whose top-left corner is
+//        at the input coordinates of `grid`
+// pre  : None
+// post : None, aside from description
+HashLife::Node *HashLife::build(Grid &grid, int level, int64_t x, int64_t y) {
+    if ((x >= width) || (y >= height)) {
+        return empty(level);
+    }
+    if (level == 0) {
+        return leaves[grid.get_tile(x, y)];
+    }
+    int64_t half = int64_t(1) << (level - 1);
+    return join(
+        build(grid, level - 1, x,        y       ),
+        build(grid, level - 1, x + half, y       ),
+        build(grid, level - 1, x,        y + half),
+        build(grid, level - 1, x + half, y + half)
+    );
+}
+
+// desc : Forgets every cached result
+// pre  : None
+// post : None, aside from description
+void HashLife::clear_results() {
+    for (Node *node : table) {
+        for (; node != nullptr; node = node->next) {
+            node->result = nullptr;
+        }
+    }
+}
+
+// desc : Flags the input node and everything reachable from it,
+//        optionally following cached results as well as quadrants
+// pre  : None
+// post : None, aside from description
+void HashLife::mark(Node *node, bool follow_results) {
+    if ((node == nullptr) || (node->level == 0) || node->marked) {
+        return;
+    }
+    node->marked = true;
+    mark(node->nw, follow_results);
+    mark(node->ne, follow_results);
+    mark(node->sw, follow_results);
+    mark(node->se, follow_results);
+    if (follow_results) {
+        mark(node->result, follow_results);
+    }
+}
+
+// desc : Frees every unmarked node and clears cached results that
+//        point to them
+// pre  : None
+// post : None, aside from description
+void HashLife::sweep() {
+    for (Node *node : table) {
+        for (; node != nullptr; node = node->next) {
+            if (   node->marked && (node->result != nullptr)
+                && (node->result->level > 0) && !node->result->marked) {
+                node->result = nullptr;
+            }
+        }
+    }
+    for (Node *&head : table) {
+        Node **link = &head;
+        while (*link != nullptr) {
+            Node *node = *link;
+            if (node->marked) {
+                node->marked = false;
+                link = &node->next;
+            } else {
+                *link = node->next;
+                delete node;
+                node_count--;
+            }
+        }
+    }
+}
+
+// desc : Frees every node that is not reachable from the visible or
+//        pending state. Cached results are kept where possible, but
+//        are dropped if keeping them leaves the table too full.
+// pre  : None
+// post : None, aside from description
+void HashLife::collect() {
+    for (bool follow_results : { true, false }) {
+        mark(root, follow_results);
+        mark(pending, follow_results);
+        for (Node *node : empties) {
+            mark(node, false);
+        }
+        sweep();
+        if (node_count <= max_nodes / 2) {
+            break;
+        }
+    }
+}
+
+// desc : Creates an engine evolving the input grid's pattern, where
+//        each step advances 2^step_exp generations and the node cache
+//        is garbage collected once it exceeds `max_nodes` nodes. The
+//        grid is taken to be generation `generation` of the pattern.
+// pre  : `step_exp` must be in the range [0,48]
+// post : None, aside from description
+HashLife::HashLife(Grid &grid, int step_exp, size_t max_nodes, uint64_t generation)
+    : table(1 << 16, nullptr)
+    , node_count(0)
+    , max_nodes(max_nodes)
+    , pending(nullptr)
+    , step_exp(step_exp)
+    , rule(0)
+    , generation(generation)
+    , width(grid.get_width())
+    , height(grid.get_height())
+{
+    leaves[0] = new Node { nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, 0, 0, false };
+    leaves[1] = new Node { nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, 1, 0, false };
+
+    // Place the pattern in the south-east quadrant of the root, so that
+    // its top-left corner sits at the root's center
+    int level = 3;
+    while ((int64_t(1) << (level - 1)) < std::max(width, height)) {
+        level++;
+    }
+    Node *e = empty(level - 1);
+    root = join(e, e, e, build(grid, level - 1, 0, 0));
+}
+
+// desc : Frees every node
+// pre  : None
+// post : None, aside from description
+HashLife::~HashLife() {
+    for (Node *node : table) {
+        while (node != nullptr) {
+            Node *next = node->next;
+            delete node;
+            node = next;
+        }
+    }
+    delete leaves[0];
+    delete leaves[1];
+}
+
+// desc : Advances the root by 2^step_exp generations, first padding it
+//        with empty space until nothing can escape the square that the
+//        step computes
+// pre  : Any step computed previously must have been committed, and
+//        the engine must support `rule`
+// post : None, aside from description
+void HashLife::step(int rule) {
+    if (rule != this->rule) {
+        clear_results();
+        this->rule = rule;
+    }
+
+    Node *node = root;
+    while (   (node->level < step_exp + 3)
+           || (center(center(node))->population != node->population)) {
+        node = expand(node);
+    }
+    pending = successor(node);
+
+    if (node_count > max_nodes) {
+        collect();
+    }
+}
+
+// desc : Makes the pending root visible
+// pre  : `step` must have been called since the last commit
+// post : None, aside from description
+void HashLife::commit() {
+    root    = pending;
+    pending = nullptr;
+    generation += uint64_t(1) << step_exp;
+}
+
+// desc : Returns whether or not the tile at the input coordinates is
+//        alive, by walking down the quadtree from the root
+// pre  : None
+// post : None, aside from description
+bool HashLife::get_tile(int64_t x, int64_t y) {
+    Node   *node = root;
+    int64_t half = int64_t(1) << (node->level - 1);
+    if ((x < -half) || (x >= half) || (y < -half) || (y >= half)) {
+        return false;
+    }
+    // Shift coordinates to be relative to the root's top-left corner
+    x += half;
+    y += half;
+    while (node->level > 0) {
+        if (node->population == 0) {
+            return false;
+        }
+        int64_t quarter = int64_t(1) << (node->level - 1);
+        bool east  = x >= quarter;
+        bool south = y >= quarter;
+        node = south ? (east ? node->se : node->sw)
+                     : (east ? node->ne : node->nw);
+        x -= east  ? quarter : 0;
+        y -= south ? quarter : 0;
+    }
+    return node->population != 0;
+}
+
+// desc : Returns the fraction of live tiles in the square, read off the
+//        population of the node that covers it exactly
+// pre  : `scale` must be a power of two, and both coordinates must be
+//        multiples of it
+// post : None, aside from description
+double HashLife::density(int64_t x, int64_t y, int64_t scale) {
+    Node   *node  = root;
+    int     level = __builtin_ctzll(scale);
+    double  area  = double(scale) * double(scale);
+
+    // Squares at least as large as the root meet at its center, so each
+    // holds at most one of its quadrants
+    if (level >= node->level) {
+        if (((x != -scale) && (x != 0)) || ((y != -scale) && (y != 0))) {
+            return 0;
+        }
+        node = (y < 0) ? ((x < 0) ? node->nw : node->ne)
+                       : ((x < 0) ? node->sw : node->se);
+        return node->population / area;
+    }
+
+    int64_t half = int64_t(1) << (node->level - 1);
+    if ((x < -half) || (x >= half) || (y < -half) || (y >= half)) {
+        return 0;
+    }
+    // Shift coordinates to be relative to the root's top-left corner
+    x += half;
+    y += half;
+    while ((node->level > level) && (node->population != 0)) {
+        int64_t quarter = int64_t(1) << (node->level - 1);
+        bool east  = x >= quarter;
+        bool south = y >= quarter;
+        node = south ? (east ? node->se : node->sw)
+                     : (east ? node->ne : node->nw);
+        x -= east  ? quarter : 0;
+        y -= south ? quarter : 0;
+    }
+    return node->population / area;
+}
+
+// desc : Returns the width of the initial pattern
+// pre  : None
+// post : None, aside from description
+int64_t HashLife::get_width() {
+    return width;
+}
+
+// desc : Returns the height of the initial pattern
+// pre  : None
+// post : None, aside from description
+int64_t HashLife::get_height() {
+    return height;
+}
+
+// desc : Returns the number of live tiles on the whole plane
+// pre  : None
+// post : None, aside from description
+uint64_t HashLife::population() {
+    return root->population;
+}
+
+// desc : Returns the number of committed generations
+// pre  : None
+// post : None, aside from description
+uint64_t HashLife::get_generation() {
+    return generation;
+}
+
+// desc : Returns the engine's name, step size, and cache size
+// pre  : None
+// post : None, aside from description
+std::string HashLife::describe() {
+    return "hashlife (2^" + std::to_string(step_exp) + " generations per step, "
+         + std::to_string(node_count) + " cached nodes)";
+}
+
+// desc : Reports whether the rule leaves dead tiles with no live
+//        neighbors dead, since births from nothing would fill the
+//        infinite empty plane, which a quadtree can't represent
+// pre  : None
+// post : None, aside from description
+bool HashLife::supports_rule(int rule) {
+    return (rule & 1) == 0;
+}
@@ -0,0 +1,165 @@
+#ifndef HASHLIFE
+#define HASHLIFE
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "engine.h"
+#include "grid.h"
+
+///////////////////////////////////////////////////////////
+// Evolves a pattern on an unbounded plane using Gosper's
+// HashLife algorithm.
+//
+// The plane is a quadtree of canonicalized nodes: any two
+// squares with the same content share a node, found through
+// a hash table keyed on a node's four children. Each node
+// caches its RESULT, the center half of its square advanced
+// by 2^min(level-2, step exponent) generations, so repeated
+// content is only ever evolved once and a single step can
+// cover 2^(step exponent) generations.
+///////////////////////////////////////////////////////////
+class HashLife : public Engine {
+
+    // A square of 2^level by 2^level tiles
+    struct Node {
+        // The quadrants of the square, which are null for leaves
+        Node     *nw;
+        Node     *ne;
+        Node     *sw;
+        Node     *se;
+        // The next node in the same hash table bucket
+        Node     *next;
+        // The cached center of the square after stepping, or null
+        // if it hasn't been computed yet
+        Node     *result;
+        // The number of live tiles in the square
+        uint64_t  population;
+        int       level;
+        // Used by the garbage collector to flag reachable nodes
+        bool      marked;
+    };
+
+    // Hash table of every non-leaf node, chained through `next`
+    std::vector<Node*> table;
+    size_t             node_count;
+    // Node count above which the garbage collector runs
+    size_t             max_nodes;
+
+    // The dead and live single tiles, which live outside the table
+    Node              *leaves[2];
+    // The empty node of each level, built on demand
+    std::vector<Node*> empties;
+
+    // The visible state, and the state computed by the last step
+    // that has yet to be committed. The center of the root square
+    // is always at coordinates (0,0).
+    Node              *root;
+    Node              *pending;
+
+    // Each step advances 2^step_exp generations
+    int                step_exp;
+    // The rule the cached results were computed with
+    int                rule;
+    uint64_t           generation;
+
+    // The dimensions of the initial pattern
+    int64_t            width;
+    int64_t            height;
+
+    // desc : Returns the canonical node with the input quadrants,
+    //        creating it if it doesn't exist yet
+    // pre  : All quadrants must share a level
+    // post : None, aside from description
+    Node *join(Node *nw, Node *ne, Node *sw, Node *se);
+
+    // desc : Returns the canonical empty node of the input level
+    // pre  : None
+    // post : None, aside from description
+    Node *empty(int level);
+
+    // desc : Returns a node one level up, with the input node at its
+    //        center and empty space around it
+    // pre  : `node` must not be a leaf
+    // post : None, aside from description
+    Node *expand(Node *node);
+
+    // desc : Returns the center half of the input node, unstepped
+    // pre  : `node` must be at least level 2
+    // post : None, aside from description
+    Node *center(Node *node);
+
+    // desc : Computes the center 2x2 of a 4x4 node, one generation later
+    // pre  : `node` must be level 2
+    // post : None, aside from description
+    Node *base_step(Node *node);
+
+    // desc : Returns the RESULT of the input node, computing and caching
+    //        it if necessary
+    // pre  : `node` must be at least level 2
+    // post : None, aside from description
+    Node *successor(Node *node);
+
+    // desc : Builds the node of the input level whose top-left corner is
+    //        at the input coordinates of `grid`
+    // pre  : None
+    // post : None, aside from description
+    Node *build(Grid &grid, int level, int64_t x, int64_t y);
+
+    // desc : Grows the hash table and redistributes its nodes
+    // pre  : None
+    // post : None, aside from description
+    void rehash();
+
+    // desc : Forgets every cached result
+    // pre  : None
+    // post : None, aside from description
+    void clear_results();
+
+    // desc : Flags the input node and everything reachable from it,
+    //        optionally following cached results as well as quadrants
+    // pre  : None
+    // post : None, aside from description
+    void mark(Node *node, bool follow_results);
+
+    // desc : Frees every node that is not reachable from the visible or
+    //        pending state. Cached results are kept where possible, but
+    //        are dropped if keeping them leaves the table too full.
+    // pre  : None
+    // post : None, aside from description
+    void collect();
+
+    // desc : Frees every unmarked node and clears cached results that
+    //        point to them
+    // pre  : None
+    // post : None, aside from description
+    void sweep();
+
+    public:
+
+    // desc : Creates an engine evolving the input grid's pattern, where
+    //        each step advances 2^step_exp generations and the node cache
+    //        is garbage collected once it exceeds `max_nodes` nodes. The
+    //        grid is taken to be generation `generation` of the pattern.
+    // pre  : `step_exp` must be in the range [0,48]
+    // post : None, aside from description
+    HashLife(Grid &grid, int step_exp, size_t max_nodes, uint64_t generation = 0);
+
+    // desc : Frees every node
+    // pre  : None
+    // post : None, aside from description
+    ~HashLife();
+
+    void        step(int rule) override;
+    void        commit() override;
+    bool        get_tile(int64_t x, int64_t y) override;
+    int64_t     get_width() override;
+    int64_t     get_height() override;
+    uint64_t    population() override;
+    uint64_t    get_generation() override;
+    std::string describe() override;
+    double      density(int64_t x, int64_t y, int64_t scale) override;
+    bool        supports_rule(int rule) override;
+};
+
+#endif //HASHLIFE
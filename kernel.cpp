@@ -0,0 +1,328 @@
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "kernel.h"
+
+// GCC vectors of 2, 4, and 8 words, stepped by the SSE2, AVX2, and
+// AVX-512 kernels respectively
+typedef uint64_t Words2 __attribute__((vector_size(16)));
+typedef uint64_t Words4 __attribute__((vector_size(32)));
+typedef uint64_t Words8 __attribute__((vector_size(64)));
+
+// The signature shared by every kernel
+typedef void (*RowKernel)(uint64_t const *above, uint64_t const *middle,
+                          uint64_t const *below, uint64_t *out,
+                          int count, int rule);
+
+// desc : Reads a `Word` (possibly a vector) from an unaligned address
+// pre  : None
+// post : None, aside from description
+template<typename Word>
+__attribute__((always_inline))
+static inline Word load(uint64_t const *source) {
+    Word value;
+    std::memcpy(&value, source, sizeof(Word));
+    return value;
+}
+
+// desc : Steps `count` words of a row, sizeof(Word)/8 words at a time,
+//        finishing any leftover words one by one. Reading the west and
+//        east words at offsets -1 and +1 lines the neighbors of every lane
+//        up at once.
+// pre  : Same as `step_row`
+// post : None, aside from description
+template<typename Word>
+__attribute__((always_inline))
+static inline void step_lanes(uint64_t const *above, uint64_t const *middle,
+                              uint64_t const *below, uint64_t *out,
+                              int count, int rule) {
+    const int lanes = sizeof(Word) / sizeof(uint64_t);
+    int i = 0;
+    for (; i + lanes <= count; i += lanes) {
+        Word value = step_word<Word>(
+            load<Word>(above +i-1), load<Word>(above +i), load<Word>(above +i+1),
+            load<Word>(middle+i-1), load<Word>(middle+i), load<Word>(middle+i+1),
+            load<Word>(below +i-1), load<Word>(below +i), load<Word>(below +i+1),
+            rule
+        );
+        std::memcpy(out + i, &value, sizeof(Word));
+    }
+    for (; i < count; i++) {
+        out[i] = step_word<uint64_t>(above[i-1],  above[i],  above[i+1],
+                                     middle[i-1], middle[i], middle[i+1],
+                                     below[i-1],  below[i],  below[i+1],
+                                     rule);
+    }
+}
+
+// Each kernel below is a template on the rule it steps, where -1 means
+// the rule is read at runtime and anything else is a compile-time
+// constant that the kernel is specialized for.
+
+// desc : Steps one word at a time, using only general purpose registers
+// pre  : Same as `step_row`
+// post : None, aside from description
+template<int Rule>
+static void step_row_scalar(uint64_t const *above, uint64_t const *middle,
+                            uint64_t const *below, uint64_t *out,
+                            int count, int rule) {
+    step_lanes<uint64_t>(above, middle, below, out, count, (Rule < 0) ? rule : Rule);
+}
+
+#if defined(__x86_64__)
+
+// desc : Steps 2 words (128 tiles) at a time with SSE2
+// pre  : Same as `step_row`
+// post : None, aside from description
+template<int Rule>
+__attribute__((target("sse2")))
+static void step_row_sse2(uint64_t const *above, uint64_t const *middle,
+                          uint64_t const *below, uint64_t *out,
+                          int count, int rule) {
+    step_lanes<Words2>(above, middle, below, out, count, (Rule < 0) ? rule : Rule);
+}
+
+// desc : Steps 4 words (256 tiles) at a time with AVX2
+// pre  : Same as `step_row`
+// post : None, aside from description
+template<int Rule>
+__attribute__((target("avx2")))
+static void step_row_avx2(uint64_t const *above, uint64_t const *middle,
+                          uint64_t const *below, uint64_t *out,
+                          int count, int rule) {
+    step_lanes<Words4>(above, middle, below, out, count, (Rule < 0) ? rule : Rule);
+}
+
+// desc : Steps 8 words (512 tiles) at a time with AVX-512
+// pre  : Same as `step_row`
+// post : None, aside from description
+template<int Rule>
+__attribute__((target("avx512f")))
+static void step_row_avx512(uint64_t const *above, uint64_t const *middle,
+                            uint64_t const *below, uint64_t *out,
+                            int count, int rule) {
+    step_lanes<Words8>(above, middle, below, out, count, (Rule < 0) ? rule : Rule);
+}
+
+#endif
+
+// The instantiations of a kernel template for every slot returned by
+// `rule_slot`
+typedef std::array<RowKernel, specialized_count + 1> RuleKernels;
+
+// desc : Returns the instantiations of a kernel template for every slot,
+//        given a function that takes a std::integral_constant holding a
+//        rule and returns the kernel's instantiation for it
+// pre  : None
+// post : None, aside from description
+template<typename Instantiate, size_t... Slots>
+static RuleKernels rule_kernels(Instantiate instantiate, std::index_sequence<Slots...>) {
+    return { instantiate(std::integral_constant<int, -1>()),
+             instantiate(std::integral_constant<int, specialized_rules[Slots]>())... };
+}
+
+// Every instantiation of a kernel template, indexed by `rule_slot`
+#define RULE_KERNELS(kernel)                                                        \
+    rule_kernels([](auto rule) -> RowKernel { return kernel<decltype(rule)::value>; },  \
+                 std::make_index_sequence<specialized_count>())
+
+// A kernel's instantiations, its name, and whether the CPU can run it
+struct KernelEntry {
+    char const *name;
+    RuleKernels by_rule;
+    bool        supported;
+};
+
+// desc : Returns every kernel, from narrowest to widest
+// pre  : None
+// post : None, aside from description
+static std::vector<KernelEntry> const &kernels() {
+    static std::vector<KernelEntry> const entries = {
+        { "scalar", RULE_KERNELS(step_row_scalar), true },
+#if defined(__x86_64__)
+        { "sse2",   RULE_KERNELS(step_row_sse2),   (bool) __builtin_cpu_supports("sse2")    },
+        { "avx2",   RULE_KERNELS(step_row_avx2),   (bool) __builtin_cpu_supports("avx2")    },
+        { "avx512", RULE_KERNELS(step_row_avx512), (bool) __builtin_cpu_supports("avx512f") },
+#endif
+    };
+    return entries;
+}
+
+// desc : Returns the index of the widest kernel the CPU supports
+// pre  : None
+// post : None, aside from description
+static size_t widest_kernel() {
+    size_t best = 0;
+    for (size_t i=0; i<kernels().size(); i++) {
+        if (kernels()[i].supported) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+// The index of the kernel used by `step_row`. Atomic, since the input
+// thread may fall back to the scalar kernel while a step is running.
+static std::atomic<size_t> active(widest_kernel());
+
+// desc : Computes the next state of `count` consecutive words of a row,
+//        given the corresponding words of the row itself and of the rows
+//        directly above and below it, using the kernel selected for this
+//        CPU
+// pre  : The words at index -1 and `count` of each input row must be
+//        readable
+// post : None, aside from description
+void step_row(uint64_t const *above, uint64_t const *middle,
+              uint64_t const *below, uint64_t *out, int count, int rule) {
+    // Picking the instantiation per call means a new rule takes effect on
+    // the very next row, with nothing to rebuild
+    kernels()[active].by_rule[rule_slot(rule)](above, middle, below, out, count, rule);
+}
+
+// desc : Returns the name of the kernel used by `step_row`
+// pre  : None
+// post : None, aside from description
+std::string kernel_name() {
+    return kernels()[active].name;
+}
+
+// desc : Makes `step_row` use the named kernel, returning false if the
+//        name is unknown or the CPU doesn't support it
+// pre  : Must not be called while a step is in progress
+// post : None, aside from description
+bool set_kernel(std::string name) {
+    for (size_t i=0; i<kernels().size(); i++) {
+        if ((kernels()[i].name == name) && kernels()[i].supported) {
+            active = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// desc : Runs the input kernel, instantiated for the input rule, and the
+//        generic scalar kernel over the same three random rows, returning
+//        whether they produced the same words
+// pre  : None
+// post : None, aside from description
+static bool matches_scalar(KernelEntry const &entry, int rule, std::mt19937_64 &rng) {
+    // Odd lengths exercise the leftover words after the last full vector,
+    // and sparse rows exercise low neighbor counts
+    const int count = 37;
+    uint64_t rows[3][count + 2];
+    uint64_t density = rng() % 4;
+    for (auto &row : rows) {
+        for (uint64_t &word : row) {
+            word = rng();
+            for (uint64_t d=0; d<density; d++) {
+                word &= rng();
+            }
+        }
+    }
+    uint64_t expected[count];
+    uint64_t actual[count];
+    RowKernel kernel = entry.by_rule[rule_slot(rule)];
+    step_row_scalar<-1>(rows[0]+1, rows[1]+1, rows[2]+1, expected, count, rule);
+    kernel             (rows[0]+1, rows[1]+1, rows[2]+1, actual,   count, rule);
+    return std::memcmp(expected, actual, sizeof(expected)) == 0;
+}
+
+// desc : Runs the scalar kernel over a random 3x64 patch and compares the
+//        middle row against the tile-by-tile definition of the rule
+// pre  : None
+// post : None, aside from description
+static bool matches_definition(int rule, std::mt19937_64 &rng) {
+    uint64_t rows[3][3] = {
+        { 0, rng() & rng(), 0 },
+        { 0, rng() & rng(), 0 },
+        { 0, rng() & rng(), 0 },
+    };
+    uint64_t result;
+    step_row_scalar<-1>(rows[0]+1, rows[1]+1, rows[2]+1, &result, 1, rule);
+    for (int x=0; x<64; x++) {
+        int count = 0;
+        for (int dy=0; dy<3; dy++) {
+            for (int dx=-1; dx<=1; dx++) {
+                if (((dy != 1) || (dx != 0)) && (x+dx >= 0) && (x+dx < 64)) {
+                    count += (rows[dy][1] >> (x+dx)) & 1;
+                }
+            }
+        }
+        bool alive = (rows[1][1] >> x) & 1;
+        if (((result >> x) & 1) != ((rule >> ((alive*9)+count)) & 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// desc : Checks that the active kernel produces the same words as the
+//        scalar kernel for random rows under the input rule, falling
+//        back to the scalar kernel if it doesn't. Returns whether the
+//        kernels agreed.
+// pre  : Must not be called while a step is in progress
+// post : None, aside from description
+bool verify_kernel(int rule) {
+    std::mt19937_64 rng(rule);
+    for (int trial=0; trial<16; trial++) {
+        if (!matches_scalar(kernels()[active], rule, rng)) {
+            active = 0;
+            return false;
+        }
+    }
+    return true;
+}
+
+// desc : Compares every kernel the CPU supports against the scalar
+//        kernel, and the scalar kernel against a tile-by-tile reference,
+//        over random rows and random rules, writing a report to `out`.
+//        Returns whether all kernels agreed.
+// pre  : None
+// post : None, aside from description
+bool kernel_self_check(std::ostream &out) {
+    std::mt19937_64 rng(std::random_device{}());
+
+    // Rules users can type are any positive int, though only the low 18
+    // bits mean anything. Include the well-known ones alongside random
+    // values of every magnitude.
+    std::vector<int> rules = {
+        rule_life, rule_highlife, rule_seeds, rule_day_night,
+        rule_life | (1 << 20), 1, rule_mask, 0x7FFFFFFF
+    };
+    for (int i=0; i<2000; i++) {
+        rules.push_back(1 + (rng() % 0x7FFFFFFF) % (1 << (1 + rng() % 31)));
+    }
+
+    bool all_passed = true;
+    int reference_failures = 0;
+    for (int rule : rules) {
+        reference_failures += !matches_definition(rule, rng);
+    }
+    out << "scalar vs definition: " << (reference_failures ? "FAIL" : "ok")
+        << " (" << rules.size() - reference_failures << '/' << rules.size()
+        << " rules match)\n";
+    all_passed = all_passed && (reference_failures == 0);
+
+    // The scalar kernel's specializations are checked against its
+    // generic instantiation along with every other kernel
+    for (size_t k=0; k<kernels().size(); k++) {
+        KernelEntry const &entry = kernels()[k];
+        if (!entry.supported) {
+            out << entry.name << ": not supported by this CPU\n";
+            continue;
+        }
+        int failures = 0;
+        for (int rule : rules) {
+            for (int trial=0; trial<4; trial++) {
+                failures += !matches_scalar(entry, rule, rng);
+            }
+        }
+        out << entry.name << " vs scalar: " << (failures ? "FAIL" : "ok")
+            << " (" << failures << " mismatches)\n";
+        all_passed = all_passed && (failures == 0);
+    }
+    out << "active kernel: " << kernel_name() << '\n';
+    return all_passed;
+}
@@ -0,0 +1,190 @@
+#ifndef KERNEL
+#define KERNEL
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+// Rules that get kernels specialized at compile time
+const int rule_life      = 6152;    // B3/S23, Conway's Game of Life
+const int rule_highlife  = 6216;    // B36/S23, HighLife
+const int rule_seeds     = 4;       // B2/S, Seeds
+const int rule_day_night = 242120;  // B3678/S34678, Day & Night
+
+// Only the low 18 bits of a rule integer affect stepping
+const int rule_mask      = 0x3FFFF;
+
+// Every rule above, in the order kernels are specialized for them. Both
+// `with_rule` and the kernel tables are built from this list, so it is
+// the only place a rule needs adding to get its own kernels.
+constexpr int  specialized_rules[] = { rule_life, rule_highlife, rule_seeds, rule_day_night };
+const size_t   specialized_count   = sizeof(specialized_rules) / sizeof(specialized_rules[0]);
+
+// desc : Returns one more than the position of the input rule in
+//        `specialized_rules`, or 0 if it isn't specialized, which is where
+//        tables indexed by rule keep the instantiation reading the rule
+//        at runtime
+// pre  : None
+// post : None, aside from description
+constexpr int rule_slot(int rule) {
+    for (size_t i = 0; i < specialized_count; i++) {
+        if ((rule & rule_mask) == specialized_rules[i]) {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+// desc : Calls `function` with a std::integral_constant holding the
+//        specialized rule in the input slot, or holding -1 if the slot
+//        is 0, by testing each slot in `Slots` in turn
+// pre  : `slot` must be a slot returned by `rule_slot`
+// post : None, aside from description
+template<typename Function, size_t... Slots>
+inline void with_slot(int slot, Function &function, std::index_sequence<Slots...>) {
+    bool found = ((slot == Slots + 1
+                   && (function(std::integral_constant<int, specialized_rules[Slots]>()), true)) || ...);
+    if (!found) {
+        function(std::integral_constant<int, -1>());
+    }
+}
+
+// desc : Calls `function` with a std::integral_constant holding the input
+//        rule if it matches one of the specialized rules, or holding -1
+//        (meaning "read the rule at runtime") otherwise. This lets callers
+//        instantiate a template per specialized rule.
+// pre  : None
+// post : None, aside from description
+template<typename Function>
+inline void with_rule(int rule, Function function) {
+    with_slot(rule_slot(rule), function, std::make_index_sequence<specialized_count>());
+}
+
+// desc : Adds three words bitwise, as though each bit position were an
+//        independent one-bit full adder, storing the sum bits in `sum`
+//        and the carry bits in `carry`
+// pre  : None
+// post : None, aside from description
+template<typename Word>
+__attribute__((always_inline))
+inline void full_add(Word a, Word b, Word c, Word &sum, Word &carry) {
+    Word half = a ^ b;
+    sum   = half ^ c;
+    carry = (a & b) | (half & c);
+}
+
+// desc : Computes the next state of a word of 64 tiles (bit i holding the
+//        tile at offset i), given that word of the row itself and of the
+//        rows directly above and below it. For each of the three rows,
+//        bit 63 of the `west` word is the tile left of bit 0, and bit 0 of
+//        the `east` word is the tile right of bit 63. Each output bit is
+//        looked up in the rule as `(rule>>((alive*9)+neighbors))&1`, with
+//        the neighbor count of all 64 tiles computed at once by bit-sliced
+//        adders.
+//
+//        `Word` may also be a GCC vector of uint64_t, in which case each
+//        lane is an independent word and the lanes are stepped together.
+//        It is always inlined so that vector instantiations are compiled
+//        for the instruction set of the function using them.
+// pre  : None
+// post : None, aside from description
+template<typename Word>
+__attribute__((always_inline))
+inline Word step_word(Word above_west, Word above, Word above_east,
+                      Word west,       Word mid,   Word east,
+                      Word below_west, Word below, Word below_east,
+                      int rule) {
+    // Each of the eight neighbors of every tile in the word, as a
+    // word aligned with the tiles they neighbor
+    Word n  = above;
+    Word nw = (n << 1) | (above_west >> 63);
+    Word ne = (n >> 1) | (above_east << 63);
+    Word s  = below;
+    Word sw = (s << 1) | (below_west >> 63);
+    Word se = (s >> 1) | (below_east << 63);
+    Word w  = (mid << 1) | (west >> 63);
+    Word e  = (mid >> 1) | (east << 63);
+
+    // Sum the neighbors into the four bit planes of a 0-8 count
+    Word top_sum, top_carry, bot_sum, bot_carry;
+    full_add(nw, n, ne, top_sum, top_carry);
+    full_add(sw, s, se, bot_sum, bot_carry);
+    Word mid_sum   = w ^ e;
+    Word mid_carry = w & e;
+
+    Word bit0, ones_carry;
+    full_add(top_sum, bot_sum, mid_sum, bit0, ones_carry);
+    Word twos, fours_a;
+    full_add(top_carry, bot_carry, mid_carry, twos, fours_a);
+    Word bit1    = twos ^ ones_carry;
+    Word fours_b = twos & ones_carry;
+    Word bit2    = fours_a ^ fours_b;
+    Word bit3    = fours_a & fours_b;
+
+    // Select the tiles whose (alive,count) pair is set in the rule. When
+    // the rule is a compile-time constant, unrolling this loop folds it
+    // down to the handful of gates that rule actually needs.
+    Word result = {};
+    #pragma GCC unroll 9
+    for (int k=0; k<=8; k++) {
+        bool birth    = (rule >> k) & 1;
+        bool survival = (rule >> (9+k)) & 1;
+        if (!birth && !survival) {
+            continue;
+        }
+        Word match = ((k & 1) ? bit0 : ~bit0)
+                   & ((k & 2) ? bit1 : ~bit1)
+                   & ((k & 4) ? bit2 : ~bit2)
+                   & ((k & 8) ? bit3 : ~bit3);
+        if (!birth) {
+            match &= mid;
+        } else if (!survival) {
+            match &= ~mid;
+        }
+        result |= match;
+    }
+    return result;
+}
+
+// desc : Computes the next state of `count` consecutive words of a row,
+//        given the corresponding words of the row itself and of the rows
+//        directly above and below it, using the kernel selected for this
+//        CPU, specialized for the input rule where possible
+// pre  : The words at index -1 and `count` of each input row must be
+//        readable
+// post : None, aside from description
+void step_row(uint64_t const *above, uint64_t const *middle,
+              uint64_t const *below, uint64_t *out, int count, int rule);
+
+// desc : Returns the name of the kernel used by `step_row`: one of
+//        "scalar", "sse2", "avx2" or "avx512". The widest kernel the CPU
+//        supports is chosen at startup.
+// pre  : None
+// post : None, aside from description
+std::string kernel_name();
+
+// desc : Makes `step_row` use the named kernel, returning false if the
+//        name is unknown or the CPU doesn't support it
+// pre  : Must not be called while a step is in progress
+// post : None, aside from description
+bool set_kernel(std::string name);
+
+// desc : Checks that the active kernel produces the same words as the
+//        scalar kernel for random rows under the input rule, falling
+//        back to the scalar kernel if it doesn't. Returns whether the
+//        kernels agreed.
+// pre  : Must not be called while a step is in progress
+// post : None, aside from description
+bool verify_kernel(int rule);
+
+// desc : Compares every kernel the CPU supports against the scalar
+//        kernel, and the scalar kernel against a tile-by-tile reference,
+//        over random rows and random rules, writing a report to `out`.
+//        Returns whether all kernels agreed.
+// pre  : None
+// post : None, aside from description
+bool kernel_self_check(std::ostream &out);
+
+#endif //KERNEL
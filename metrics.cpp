@@ -0,0 +1,95 @@
+#include <algorithm>
+#include "metrics.h"
+
+// desc : Initializes the histogram as empty
+// pre  : None
+// post : None, aside from description
+Histogram::Histogram()
+    : count(0)
+    , total(0)
+    , longest(0)
+{
+    for (auto &bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+// desc : Counts the input duration in the bucket of the highest power of
+//        two microseconds it reaches
+// pre  : Must not be called concurrently with itself
+// post : None, aside from description
+void Histogram::record(std::chrono::steady_clock::duration duration) {
+    uint64_t nanoseconds  = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+    uint64_t microseconds = nanoseconds / 1000;
+    int      bucket       = (microseconds < 2) ? 0 : 63 - __builtin_clzll(microseconds);
+    bucket = std::min(bucket, bucket_count - 1);
+
+    buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(nanoseconds, std::memory_order_relaxed);
+    if (nanoseconds > longest.load(std::memory_order_relaxed)) {
+        longest.store(nanoseconds, std::memory_order_relaxed);
+    }
+}
+
+// desc : Returns the number of durations recorded
+// pre  : None
+// post : None, aside from description
+uint64_t Histogram::get_count() {
+    return count.load(std::memory_order_relaxed);
+}
+
+// desc : Returns the mean of the durations recorded, in milliseconds, or 0
+//        if there are none
+// pre  : None
+// post : None, aside from description
+double Histogram::mean() {
+    uint64_t n = get_count();
+    return (n == 0) ? 0 : total.load(std::memory_order_relaxed) / 1e6 / n;
+}
+
+// desc : Returns the longest duration recorded, in milliseconds
+// pre  : None
+// post : None, aside from description
+double Histogram::max() {
+    return longest.load(std::memory_order_relaxed) / 1e6;
+}
+
+// desc : Returns the upper edge of the bucket in which the running count
+//        of durations first reaches the input fraction of them, in
+//        milliseconds, capped at the longest duration
+// pre  : `fraction` must be in the range [0,1]
+// post : None, aside from description
+double Histogram::percentile(double fraction) {
+    uint64_t n = get_count();
+    if (n == 0) {
+        return 0;
+    }
+    double   target  = fraction * n;
+    uint64_t running = 0;
+    for (int i = 0; i < bucket_count; i++) {
+        running += buckets[i].load(std::memory_order_relaxed);
+        if ((running >= target) && (running > 0)) {
+            return std::min(double(uint64_t(2) << i) / 1e3, max());
+        }
+    }
+    return max();
+}
+
+// desc : Writes the histogram as lines of `name.field value`, giving the
+//        count, mean, percentiles, and maximum, then every bucket by its
+//        upper bound in microseconds
+// pre  : None
+// post : None, aside from description
+void Histogram::write(std::ostream &out, std::string const &name) {
+    out << name << ".count "   << get_count()       << '\n'
+        << name << ".mean_ms " << mean()            << '\n'
+        << name << ".p50_ms "  << percentile(0.5)   << '\n'
+        << name << ".p90_ms "  << percentile(0.9)   << '\n'
+        << name << ".p99_ms "  << percentile(0.99)  << '\n'
+        << name << ".max_ms "  << max()             << '\n';
+    for (int i = 0; i < bucket_count; i++) {
+        out << name << ".bucket_us." << (uint64_t(2) << i) << ' '
+            << buckets[i].load(std::memory_order_relaxed) << '\n';
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef METRICS
+#define METRICS
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+///////////////////////////////////////////////////////////
+// Counts how long something takes, in buckets whose bounds
+// double from one to the next, so that a few dozen counters
+// cover everything from a microsecond to over an hour.
+//
+// One thread records while any other reads. Each counter is
+// atomic on its own, so a reader may see a recording half
+// applied, which is good enough for a live display.
+///////////////////////////////////////////////////////////
+class Histogram {
+
+    public:
+
+    // The number of buckets. Bucket 0 counts durations under 2us,
+    // and bucket i counts durations in [2^i, 2^(i+1)) microseconds,
+    // with the last bucket also counting anything longer.
+    static const int bucket_count = 32;
+
+    private:
+
+    std::atomic<uint64_t> buckets[bucket_count];
+
+    // The number of durations recorded, their sum, and the longest one,
+    // in nanoseconds
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> total;
+    std::atomic<uint64_t> longest;
+
+    public:
+
+    // desc : Initializes the histogram as empty
+    // pre  : None
+    // post : None, aside from description
+    Histogram();
+
+    // desc : Counts the input duration
+    // pre  : Must not be called concurrently with itself
+    // post : None, aside from description
+    void record(std::chrono::steady_clock::duration duration);
+
+    // desc : Returns the number of durations recorded
+    // pre  : None
+    // post : None, aside from description
+    uint64_t get_count();
+
+    // desc : Returns the mean of the durations recorded, in milliseconds,
+    //        or 0 if there are none
+    // pre  : None
+    // post : None, aside from description
+    double mean();
+
+    // desc : Returns the longest duration recorded, in milliseconds
+    // pre  : None
+    // post : None, aside from description
+    double max();
+
+    // desc : Returns an upper bound on the input fraction of the recorded
+    //        durations, in milliseconds: the upper edge of the bucket that
+    //        durations reach that fraction in, capped at the longest one
+    // pre  : `fraction` must be in the range [0,1]
+    // post : None, aside from description
+    double percentile(double fraction);
+
+    // desc : Writes the histogram as lines of `name.field value`, giving
+    //        the count, mean, percentiles, and maximum, then every bucket
+    //        by its upper bound in microseconds
+    // pre  : None
+    // post : None, aside from description
+    void write(std::ostream &out, std::string const &name);
+};
+
+#endif //METRICS
@@ -4,96 +4,754 @@
 // required headers:
 #include "grid.h"
 #include "tui.h"
+#include "engine.h"
+#include "hashlife.h"
+#include "tiled.h"
+#include "plane.h"
+#include "kernel.h"
+#include "pattern.h"
+#include "checkpoint.h"
+#include "frame.h"
+#include "pacer.h"
+#include "metrics.h"
+#include "strips.h"
+#include "cycle.h"
 #include <thread>
 #include <mutex>
 #include <chrono>
 #include <vector>
 #include <unistd.h>
+#include <poll.h>
 #include <fstream>
+#include <filesystem>
+#include <stdexcept>
 #include <iostream>
 #include <limits>
 #include <condition_variable>
+#include <future>
 #include <memory>
+#include <algorithm>
+#include <cstdlib>
+#include <cerrno>
+#include <cmath>
+#include <sstream>
+#include <iomanip>
+#include <utility>
 
 
+// node count at which the hashlife engine garbage collects its cache
+const size_t hashlife_max_nodes = 1 << 22;
+
+// how many periods drawing and stepping may fall behind before missed
+// deadlines are skipped: late frames are dropped at once rather than
+// drawn in a burst, while the simulation catches up on a few steps
+const int frame_max_lag = 1;
+const int sim_max_lag = 8;
+
+// furthest the view can zoom out, as a power of two cells per pixel
+const int max_zoom = 40;
+
+// how many recent generations are remembered when looking for cycles,
+// which is also the longest period that can be found
+const size_t cycle_history = 1024;
+
+// what to do once the pattern is found to cycle: only report it, stop
+// stepping, or skip ahead by replaying frames saved from one period
+enum class CycleAction { report, stop, skip };
+
+// ways of drawing cells onto the terminal: two columns per cell, half
+// blocks holding two cells stacked in one terminal cell, or braille
+// patterns holding a 2x4 square of cells in one terminal cell
+enum class RenderMode { blocks, half, braille };
+
 // struct to keep track of game state:
 struct ProgramState {
     int rule;            
+    // the generation shown, which runs ahead of the engine's while a
+    // cycle is being replayed
+    uint64_t generation;
+    CycleDetector cycles;
+    CycleAction on_cycle;
+    // the rule the remembered generations evolved under, and how many
+    // generations each engine step covered when a cycle was found
+    int cycle_rule;
+    uint64_t cycle_step;
+    // a frame of each generation of the cycle found, indexed by
+    // generation within the cycle, for replaying instead of stepping
+    std::vector<Frame> cycle_frames;
     int frame_rate;
-    int sim_rate;
-    Grid *prev;
-    Grid *next;
+    int sim_rate;       // 0 steps as fast as possible
+    Pacer frame_pacer;
+    Pacer sim_pacer;
+    Histogram step_time;
+    Histogram render_time;
+    bool show_metrics;
+    Engine *engine;
+    int64_t view_x;
+    int64_t view_y;
+    int zoom;
+    RenderMode render_mode;
+    CheckpointWriter *checkpoints;
+    std::string checkpoint_path;
+    // set when a checkpoint is asked for, until the update thread takes it
+    bool checkpoint_requested;
+    FrameExchange *frames;
     tui::Canvas canvas;
     std::mutex mutex;
     bool running;
     bool paused;
     std::condition_variable cond;
+    // why the simulation stopped on its own, if it did
+    std::string error;
 };
 
-// draw function that displays the game grid
+// canvas_size function that returns the canvas dimensions needed to draw
+// a width x height area of cells in the given render mode
+std::pair<size_t, size_t> canvas_size(RenderMode mode, size_t width, size_t height) {
+    if (mode == RenderMode::half) {
+        return {width, (height + 1) / 2};
+    } else if (mode == RenderMode::braille) {
+        return {(width + 1) / 2, (height + 3) / 4};
+    }
+    return {width * 2, height};
+}
+
+// canvas_pixels function that returns how many pixels across and down a
+// width x height canvas shows in the given render mode
+std::pair<int64_t, int64_t> canvas_pixels(RenderMode mode, size_t width, size_t height) {
+    if (mode == RenderMode::half) {
+        return {width, height * 2};
+    } else if (mode == RenderMode::braille) {
+        return {width * 2, height * 4};
+    }
+    return {width / 2, height};
+}
+
+// view_size function that returns how many pixels across and down the
+// initial area of the pattern takes up at the current zoom, where each
+// pixel covers a 2^zoom x 2^zoom square of cells
+std::pair<int64_t, int64_t> view_size(ProgramState *state) {
+    int64_t scale = int64_t(1) << state->zoom;
+    return {(state->engine->get_width() + scale - 1) / scale,
+            (state->engine->get_height() + scale - 1) / scale};
+}
+
+// fit_canvas function that returns the canvas dimensions needed to draw
+// the view, cut down to fit the terminal with a row to spare
+std::pair<size_t, size_t> fit_canvas(ProgramState *state) {
+    auto [pixels_x, pixels_y] = view_size(state);
+    auto [width, height] = canvas_size(state->render_mode, pixels_x, pixels_y);
+    size_t columns = 80;
+    size_t rows = 24;
+    tui::terminal_size(columns, rows);
+    width = std::min(width, columns);
+    height = std::min(height, std::max<size_t>(rows, 2) - 1);
+    if (state->render_mode == RenderMode::blocks) {
+        width &= ~size_t(1);    // keep whole two-column cells
+    }
+    return {width, height};
+}
+
+// shade function that returns the gray a pixel is drawn with, given the
+// fraction of its cells that are alive: black when none are, and from
+// dark gray up to white otherwise, so that sparse areas stay visible
+tui::RGB shade(double density) {
+    if (density <= 0) {
+        return {0, 0, 0};
+    }
+    uint8_t level = 64 + 191 * std::sqrt(std::min(density, 1.0));
+    return {level, level, level};
+}
+
+// set_view function that points the frame at the current viewport, sized
+// to the pixels a width x height canvas shows
+void set_view(ProgramState *state, Frame &frame, std::pair<size_t, size_t> canvas) {
+    auto [pixels_x, pixels_y] = canvas_pixels(state->render_mode, canvas.first, canvas.second);
+    frame.x = state->view_x;
+    frame.y = state->view_y;
+    frame.zoom = state->zoom;
+    frame.width = pixels_x;
+    frame.height = pixels_y;
+}
+
+// sample_view function that fills the frame's pixels from the engine,
+// reusing the rows of `previous` that the engine reports as unchanged.
+// pixels past the initial area read as dead, so odd-sized views pad
+// cleanly. zoomed out, each pixel asks the engine for the density of its
+// square, so the cost follows the size of the canvas rather than the
+// number of cells it covers
+void sample_view(ProgramState *state, Frame &frame, Frame const *previous = nullptr) {
+    int64_t scale = int64_t(1) << frame.zoom;
+    frame.sample(*state->engine, (state->engine->get_width() + scale - 1) / scale,
+                 (state->engine->get_height() + scale - 1) / scale, previous);
+}
+
+// rows_per_line function that returns how many rows of pixels each row
+// of the canvas shows in the given render mode
+int rows_per_line(RenderMode mode) {
+    return (mode == RenderMode::half) ? 2 : (mode == RenderMode::braille) ? 4 : 1;
+}
+
+// paint_line function that fills row y of the canvas from the frame, in
+// the given render mode
+void paint_line(tui::Canvas &canvas, RenderMode mode, Frame const &frame, size_t y) {
+    const tui::RGB white{255, 255, 255};
+    const tui::RGB black{0, 0, 0};
+    size_t x_limit = canvas.get_width();
+
+    for (size_t x = 0; x < x_limit; ++x) {
+        tui::Tile &tile = canvas(x, y);
+        if (mode == RenderMode::blocks) {
+            // each pixel is two tiles wide so that it looks square
+            tile = shade(frame(x / 2, y));
+        } else if (mode == RenderMode::half) {
+            // the upper half block's foreground is the top pixel and its
+            // background the bottom one, and the lower half block draws a
+            // lone bottom pixel
+            double top = frame(x, y * 2);
+            double bottom = frame(x, y * 2 + 1);
+            if (top == bottom) {
+                tile = shade(top);
+            } else if (top == 0) {
+                tile = tui::Tile("\u2584", shade(bottom), black);
+            } else {
+                tile = tui::Tile("\u2580", shade(top), shade(bottom));
+            }
+        } else {
+            // braille dots are numbered down the left column, down the
+            // right column, then across the bottom row, and a dot is
+            // drawn for any pixel with a live cell
+            static const int dots[4][2] = {{0x01, 0x08}, {0x02, 0x10}, {0x04, 0x20}, {0x40, 0x80}};
+            int bits = 0;
+            for (int dy = 0; dy < 4; ++dy) {
+                for (int dx = 0; dx < 2; ++dx) {
+                    bits |= (frame(x * 2 + dx, y * 4 + dy) > 0) ? dots[dy][dx] : 0;
+                }
+            }
+            if (bits == 0) {
+                tile = black;
+            } else {
+                // U+2800 plus the dot bits, encoded as UTF-8
+                char symbol[4] = {
+                    char(0xE2),
+                    char(0xA0 | (bits >> 6)),
+                    char(0x80 | (bits & 0x3F)),
+                    '\0'
+                };
+                tile = tui::Tile(symbol, white, black);
+            }
+        }
+    }
+}
+
+// utilization function that returns the fraction of the engine's worker
+// threads' time spent working since the last call, given the pool's
+// counters as of that call, which it then updates. engines without a pool
+// report -1
+double utilization(Engine *engine, uint64_t &busy, uint64_t &capacity) {
+    WorkerPool *pool = engine->get_pool();
+    if (pool == nullptr) {
+        return -1;
+    }
+    uint64_t new_busy = pool->get_busy_time();
+    uint64_t new_capacity = pool->get_capacity_time();
+    double fraction = (new_capacity == capacity) ? 0
+                    : double(new_busy - busy) / double(new_capacity - capacity);
+    busy = new_busy;
+    capacity = new_capacity;
+    return fraction;
+}
+
+// write_overlay function that fills the overlay with the latest metrics,
+// given the readings taken from the engine for this frame
+void write_overlay(ProgramState *state, tui::TextBox &overlay, uint64_t generation,
+                   uint64_t population, int64_t changed, std::string const &cycle, double busy) {
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(2)
+         << "gen " << generation << "  pop " << population << "  changed ";
+    if (changed < 0) {
+        text << "n/a";
+    } else {
+        text << changed;
+    }
+    text << "\nstep   mean " << state->step_time.mean() << " p99 " << state->step_time.percentile(0.99)
+         << " max " << state->step_time.max() << " ms"
+         << "\nrender mean " << state->render_time.mean() << " p99 " << state->render_time.percentile(0.99)
+         << " max " << state->render_time.max() << " ms"
+         << "\nbytes  last " << state->canvas.get_frame_bytes() << "  total " << state->canvas.get_total_bytes()
+         << std::setprecision(1)
+         << "\nrates  frames " << state->frame_pacer.get_achieved() << '/' << state->frame_rate
+         << "  sim " << state->sim_pacer.get_achieved() << '/';
+    if (state->sim_rate == 0) {
+        text << "max";
+    } else {
+        text << state->sim_rate;
+    }
+    text << "\nframes dropped " << state->frames->get_dropped()
+         << "  repeated " << state->frames->get_repeated()
+         << "\ncycle  " << cycle
+         << "\nkernel " << kernel_name();
+    if (busy >= 0) {
+        text << "\nthreads " << state->engine->get_pool()->size() << "  busy " << busy * 100 << '%';
+    }
+    overlay.rewind();
+    overlay << text.str();
+}
+
+// write_metrics function that writes every metric as a line of
+// `name value`, for reading by other programs
+void write_metrics(ProgramState *state, std::ostream &out) {
+    out << "engine " << state->engine->describe() << '\n'
+        << "generation " << state->generation << '\n'
+        << "population " << state->engine->population() << '\n'
+        << "changed_tiles " << state->engine->changed_tiles() << '\n';
+    WorkerPool *pool = state->engine->get_pool();
+    if (pool != nullptr) {
+        out << "threads " << pool->size() << '\n'
+            << "utilization " << double(pool->get_busy_time()) / std::max<uint64_t>(1, pool->get_capacity_time()) << '\n';
+    }
+    if (state->cycles.get_found()) {
+        out << "cycle.period " << state->cycles.get_period() << '\n'
+            << "cycle.start " << state->cycles.get_start() << '\n';
+    }
+    out << "frame_rate.requested " << state->frame_rate << '\n'
+        << "frame_rate.achieved " << state->frame_pacer.get_achieved() << '\n'
+        << "frame_rate.skipped " << state->frame_pacer.get_skipped() << '\n'
+        << "sim_rate.requested " << state->sim_rate << '\n'
+        << "sim_rate.achieved " << state->sim_pacer.get_achieved() << '\n'
+        << "sim_rate.skipped " << state->sim_pacer.get_skipped() << '\n'
+        << "bytes.total " << state->canvas.get_total_bytes() << '\n'
+        << "bytes.displays " << state->canvas.get_frame_count() << '\n';
+    if (state->frames != nullptr) {
+        out << "frames.published " << state->frames->get_published() << '\n'
+            << "frames.dropped " << state->frames->get_dropped() << '\n'
+            << "frames.repeated " << state->frames->get_repeated() << '\n';
+    }
+    state->step_time.write(out, "step");
+    state->render_time.write(out, "render");
+}
+
+// save_metrics function that writes every metric to the file at path, if
+// one was given, and reports any failure
+int save_metrics(ProgramState *state, std::string const &path) {
+    if (path.empty()) {
+        return 0;
+    }
+    std::ofstream out(path);
+    write_metrics(state, out);
+    out.close();
+    if (!out) {
+        std::cerr << "Error: Cannot write metrics to " << path << '\n';
+        return 1;
+    }
+    return 0;
+}
+
+// describe_cycle function that returns a line saying what period the
+// pattern was found to cycle with, and from which generation
+std::string describe_cycle(ProgramState *state) {
+    uint64_t hash;
+    if (!state->engine->state_hash(hash)) {
+        return "not tracked by this engine";
+    }
+    if (!state->cycles.get_found()) {
+        return "none found";
+    }
+    return "period " + std::to_string(state->cycles.get_period()) + " from generation "
+         + std::to_string(state->cycles.get_start());
+}
+
+// cycle_phase function that returns how far into the cycle found the
+// given generation falls
+uint64_t cycle_phase(ProgramState *state, uint64_t generation) {
+    return (generation - state->cycles.get_start()) % state->cycles.get_period();
+}
+
+// catch_up function that steps the engine, without showing the steps,
+// until it holds the same state as the given generation of the cycle
+// found, which is at most one period away
+void catch_up(ProgramState *state, uint64_t generation) {
+    while (cycle_phase(state, state->engine->get_generation()) != cycle_phase(state, generation)) {
+        state->engine->step(state->cycle_rule);
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->engine->commit();
+    }
+}
+
+// watch_cycles function that remembers the hash of the engine's visible
+// generation, given how many generations the last step covered, and
+// makes room for a period of frames once a cycle is found. must be called
+// holding the mutex
+void watch_cycles(ProgramState *state, uint64_t step_generations) {
+    uint64_t hash;
+    if (state->cycles.get_found() || !state->engine->state_hash(hash)) {
+        return;
+    }
+    if (state->cycles.record(hash, state->engine->get_generation())) {
+        state->cycle_step = std::max<uint64_t>(1, step_generations);
+        if (state->on_cycle == CycleAction::skip) {
+            state->cycle_frames.assign(state->cycles.get_period(), Frame());
+        }
+    }
+}
+
+// replay function that publishes the saved frame of the generation after
+// the one shown instead of stepping, with its rows marked against the
+// frame published last, returning false if no frame of it was saved for
+// the current viewport
+bool replay(ProgramState *state, Frame &frame) {
+    uint64_t next = state->generation + state->cycle_step;
+    Frame const &saved = state->cycle_frames[cycle_phase(state, next)];
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        set_view(state, frame, fit_canvas(state));
+        if (saved.width == 0 || !saved.same_view(frame)) {
+            return false;
+        }
+        state->generation = next;
+    }
+    // the saved rows were marked against a frame from the last time
+    // round the cycle, not the one just published
+    frame = saved;
+    frame.mark(state->frames->last_published());
+    state->frames->publish();
+    return true;
+}
+
+// draw function that displays the newest frame published by the update
+// thread, without waiting on it. when the canvas already shows the frame
+// published just before, only the rows that frame marks as changed are
+// painted, and only those rows are compared when displaying
 void draw(ProgramState *state) {
 
+    // the viewport the canvas shows, which doubles as the frame sampled
+    // here when no published frame shows it
+    Frame view;
+    // the sequence number of the frame on the canvas, or 0 if the canvas
+    // shows something else, and the render mode it was painted in
+    uint64_t shown = 0;
+    RenderMode shown_mode = state->render_mode;
+
+    // the metrics overlay in the top-left corner, whether it is on screen,
+    // and the pool's counters when it was last filled
+    tui::TextBox overlay(48, 9);
+    bool overlay_shown = false;
+    uint64_t busy = 0;
+    uint64_t capacity = 0;
+
     // keep drawing as long as simulation is running
     while (state->running) {
+        auto start = std::chrono::steady_clock::now();
+        RenderMode mode;
+        bool show_metrics;
+        uint64_t generation = 0;
+        uint64_t population = 0;
+        int64_t changed = 0;
+        std::string cycle;
         {
-            // use mutex to ensure safe access to prev
+            // only hold the mutex long enough to read the viewport, and the
+            // engine's counts if the overlay shows them
+            std::lock_guard<std::mutex> lock(state->mutex);
+            show_metrics = state->show_metrics;
+            if (show_metrics) {
+                generation = state->generation;
+                population = state->engine->population();
+                changed = state->engine->changed_tiles();
+                cycle = describe_cycle(state);
+            }
+
+            // switching render modes, zooming, and resizing the terminal
+            // all change the size of the canvas
+            auto canvas = fit_canvas(state);
+            if (canvas.first != state->canvas.get_width() || canvas.second != state->canvas.get_height()) {
+                state->canvas.hide();
+                state->canvas.resize(canvas.first, canvas.second);
+                shown = 0;
+            }
+            set_view(state, view, canvas);
+            mode = state->render_mode;
+        }
+        if (mode != shown_mode) {
+            shown = 0;
+            shown_mode = mode;
+        }
+
+        // right after a pan or zoom, or while the simulation is paused,
+        // the published frames show an old viewport, so sample the new one
+        // here, holding the mutex to keep generations from being committed
+        Frame const *frame = &state->frames->reading();
+        if (!frame->same_view(view)) {
             std::lock_guard<std::mutex> lock(state->mutex);
-            size_t x_limit = state->prev->get_width();
-            size_t y_limit = state->prev->get_height();
-
-            // iterate through all tiles and update
-            for (size_t y = 0; y < y_limit; ++y) {
-                for (size_t x = 0; x < x_limit; ++x) {
-                    state->canvas(x * 2, y) = state->prev->get_tile(x, y) ? tui::RGB{255, 255, 255} : tui::RGB{0, 0, 0};
-                    state->canvas(x * 2 + 1, y) = state->canvas(x * 2, y);
+            sample_view(state, view);
+            frame = &view;
+        }
+
+        // a frame that follows the one on the canvas only needs its changed
+        // rows painted, the frame on the canvas needs nothing, and anything
+        // else is painted in full, such as after frames were dropped
+        size_t lines = state->canvas.get_height();
+        int per_line = rows_per_line(mode);
+        if (frame->sequence != 0 && frame->sequence == shown + 1) {
+            for (size_t y = 0; y < lines; ++y) {
+                bool changed = false;
+                for (int r = 0; r < per_line && (int64_t) y * per_line + r < frame->height; ++r) {
+                    changed = changed || frame->dirty[y * per_line + r];
+                }
+                if (changed) {
+                    paint_line(state->canvas, mode, *frame, y);
                 }
             }
+        } else if (frame->sequence == 0 || frame->sequence != shown) {
+            for (size_t y = 0; y < lines; ++y) {
+                paint_line(state->canvas, mode, *frame, y);
+            }
         }
+        shown = frame->sequence;
 
-        // display updated canvas and delay based on FPS
+        // display updated canvas, with the overlay drawn over it in full so
+        // that changes to the canvas underneath can't show through
         state->canvas.display();
-        std::this_thread::sleep_for(std::chrono::milliseconds(1000 / state->frame_rate));
+        if (show_metrics) {
+            write_overlay(state, overlay, generation, population, changed, cycle,
+                          utilization(state->engine, busy, capacity));
+            overlay.full_display();
+            overlay_shown = true;
+        } else if (overlay_shown) {
+            overlay.hide();
+            state->canvas.refresh();
+            state->canvas.display();
+            overlay_shown = false;
+        }
+        state->render_time.record(std::chrono::steady_clock::now() - start);
+
+        // wait for the next frame's deadline
+        state->frame_pacer.tick(state->frame_rate);
+    }
+}
+
+// checkpoint function that queues a copy of the visible generation to be
+// saved in the background under the given rule. only the update thread
+// commits, so it can take the copy without the mutex, even while the next
+// step is being computed, which never touches the visible generation
+void checkpoint(ProgramState *state, int rule) {
+    state->checkpoints->save(state->engine->snapshot(), state->checkpoint_path,
+                             state->engine->get_generation(), rule);
+}
+
+// request_checkpoint function that asks the update thread to save a
+// checkpoint, waking it in case stepping is held
+void request_checkpoint(ProgramState *state) {
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->checkpoint_requested = true;
+    }
+    state->cond.notify_all();
+}
+
+// take_checkpoint_request function that returns whether a checkpoint was
+// asked for since the last call
+bool take_checkpoint_request(ProgramState *state) {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    return std::exchange(state->checkpoint_requested, false);
+}
+
+// step function that advances the simulation by one engine step, then
+// publishes a frame of the new generation for the draw thread. once a
+// cycle is found and skipped, saved frames are published instead of
+// stepping whenever one shows the current viewport, and every frame that
+// is stepped is saved
+void step(ProgramState *state) {
+
+    // a new rule ends any cycle found: the engine first catches up with the
+    // generation shown, under the rule of the cycle, then everything
+    // remembered under the old rule is forgotten
+    if (state->rule != state->cycle_rule) {
+        if (state->cycles.get_found()) {
+            catch_up(state, state->generation);
+        }
+
+        // with no step in progress, check that the vector kernel agrees
+        // with the scalar one under the new rule. if it doesn't, the
+        // scalar kernel is used from now on, as the overlay shows
+        verify_kernel(state->rule);
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->cycles.reset();
+        state->cycle_frames.clear();
+        state->cycle_rule = state->rule;
+        watch_cycles(state, 0);
+    }
+
+    bool saving = take_checkpoint_request(state);
+    Frame *frame = state->frames ? &state->frames->writing() : nullptr;
+    bool skipping = frame && state->cycles.get_found() && state->on_cycle == CycleAction::skip;
+    if (skipping) {
+        if (replay(state, *frame)) {
+            if (saving) {
+                checkpoint(state, state->rule);
+            }
+            return;
+        }
+        catch_up(state, state->generation);
+    }
+
+    // compute the next step without blocking the draw thread. a checkpoint
+    // asked for is copied on another thread meanwhile, and only has to be
+    // done before the step is committed
+    std::future<void> copy;
+    if (saving) {
+        copy = std::async(std::launch::async, checkpoint, state, state->rule);
+    }
+    auto start = std::chrono::steady_clock::now();
+    uint64_t before = state->engine->get_generation();
+    state->engine->step(state->rule);
+    if (copy.valid()) {
+        copy.get();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->engine->commit();    // make the new step visible
+        uint64_t covered = state->engine->get_generation() - before;
+        state->generation += covered;
+        watch_cycles(state, covered);
+        if (frame) {
+            set_view(state, *frame, fit_canvas(state));
+        }
+    }
+    state->step_time.record(std::chrono::steady_clock::now() - start);
+
+    // only this thread commits, so the visible generation can be read
+    // without the mutex
+    if (frame) {
+        sample_view(state, *frame, state->frames->last_published());
+        if (state->cycles.get_found() && state->on_cycle == CycleAction::skip) {
+            state->cycle_frames[cycle_phase(state, state->generation)] = *frame;
+        }
+        state->frames->publish();
+    }
+}
+
+// finish_checkpoints function that saves a last checkpoint if asked to,
+// or if one asked for was never taken, waits for pending checkpoints to
+// be written, and reports any failure. must be called once nothing else
+// steps the engine
+int finish_checkpoints(ProgramState *state, bool checkpoint_on_exit) {
+    if (take_checkpoint_request(state) || checkpoint_on_exit) {
+        checkpoint(state, state->rule);
     }
+    state->checkpoints->wait();
+    std::string error = state->checkpoints->last_error();
+    if (!error.empty()) {
+        std::cerr << "Error: " << error << '\n';
+        return 1;
+    }
+    return 0;
 }
 
 // update function that updates state of grid
 void update(ProgramState *state) {
 
-    
     while (state->running) {
+        bool stepping = true;
         {
             std::unique_lock<std::mutex> lock(state->mutex);
-            // wait for notification from conditional variable to resume
-            while (state->paused) {
-                state->cond.wait(lock);
+            // wait for notification from conditional variable to resume,
+            // then start pacing afresh rather than catching up on the pause
+            // a pattern found to cycle stays stopped until the rule changes
+            auto held = [state] {
+                bool stopped = state->cycles.get_found() && state->on_cycle == CycleAction::stop
+                            && state->rule == state->cycle_rule;
+                return state->running && (state->paused || stopped);
+            };
+            if (held()) {
+                while (held() && !state->checkpoint_requested) {
+                    state->cond.wait(lock);
+                }
+                stepping = !held();
+                if (stepping) {
+                    state->sim_pacer.restart();
+                }
             }
         }
 
-        size_t x_limit = state->prev->get_width();
-        size_t y_limit = state->prev->get_height();
-        std::vector<std::thread> threads;   // vector to store all individual threads
-
-        // spawn threads updating each row of the grid
-        for (size_t y = 0; y < y_limit; y++) {
-            threads.emplace_back([&state, y, x_limit]() {
-                for (size_t x = 0; x < x_limit; x++) {
-                    state->next->update_tile(*state->prev, x, y, state->rule);
-                }
-            });
+        // a checkpoint asked for while held is saved without stepping
+        if (!stepping) {
+            if (take_checkpoint_request(state)) {
+                checkpoint(state, state->rule);
+            }
+            continue;
         }
 
-        // ensure all threads finish
-        for (auto &thread : threads) {
-            thread.join();
+        // an engine that can no longer step ends the simulation
+        try {
+            step(state);
+        } catch (std::runtime_error &error) {
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->error = error.what();
+                state->running = false;
+            }
+            state->cond.notify_all();
+            break;
         }
 
-        {
-            std::lock_guard<std::mutex> lock(state->mutex);
-            std::swap(state->prev, state->next);    // swap current state with prev
+        // wait for the next step's deadline, or not at all when unlimited
+        state->sim_pacer.tick(state->sim_rate);
+    }
+}
+
+// headless function that steps the engine as fast as possible, without
+// displaying it, and reports how quickly it did so. returns 1 if the
+// engine stopped being able to step, and 0 otherwise
+int headless(ProgramState *state, uint64_t generations) {
+
+    // count generations from wherever the engine starts, which may be a
+    // resumed checkpoint
+    uint64_t start_generation = state->generation;
+    uint64_t engine_start = state->engine->get_generation();
+    auto start = std::chrono::steady_clock::now();
+    try {
+        while (state->generation - start_generation < generations) {
+            // once the pattern cycles, either stop, or skip straight to the
+            // last generation by stepping into the same place in the cycle
+            if (state->cycles.get_found() && state->on_cycle == CycleAction::stop) {
+                break;
+            }
+            if (state->cycles.get_found() && state->on_cycle == CycleAction::skip) {
+                uint64_t target = start_generation + generations;
+                target += (state->cycle_step - (target - state->generation) % state->cycle_step) % state->cycle_step;
+                catch_up(state, target);
+                state->generation = target;
+                break;
+            }
+            step(state);
         }
+    } catch (std::runtime_error &error) {
+        std::cerr << "Error: " << error.what() << '\n';
+        return 1;
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    // rates only count the generations the engine actually stepped, not
+    // the ones skipped over once the pattern cycled
+    double seconds = std::chrono::duration<double>(end - start).count();
+    uint64_t simulated = state->engine->get_generation() - engine_start;
+    uint64_t skipped = (state->generation - start_generation) - simulated;
+    double cells = (double) state->engine->get_width() * state->engine->get_height();
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(1000 / state->sim_rate));
+    std::cout << "engine:          " << state->engine->describe() << '\n'
+              << "grid:            " << state->engine->get_width() << 'x'
+              << state->engine->get_height() << '\n'
+              << "generations:     " << state->generation << '\n';
+    if (skipped > 0) {
+        std::cout << "skipped:         " << skipped << " generations\n";
     }
+    std::cout << "wall time:       " << seconds << " s\n"
+              << "generations/sec: " << simulated / seconds << '\n'
+              << "cells/sec:       " << cells * simulated / seconds << '\n'
+              << "population:      " << state->engine->population() << '\n'
+              << "cycle:           " << describe_cycle(state) << '\n';
+    return 0;
 }
 
 // input function responsible for handling user inputs
@@ -103,7 +761,17 @@ void input_thread(ProgramState *state) {
     tui::Input::raw_mode();
     char c;
 
-    while (state->running && (read(0, &c, 1) == 1)) {
+    while (state->running) {
+
+        // wake now and then to notice the simulation ending on its own
+        pollfd input = {0, POLLIN, 0};
+        int ready = poll(&input, 1, 100);
+        if (ready == 0 || (ready < 0 && errno == EINTR)) {
+            continue;
+        }
+        if (ready < 0 || read(0, &c, 1) != 1) {
+            break;
+        }
        
         // if c = q we quit the simulation
         if (c == 'q') {
@@ -115,6 +783,68 @@ void input_thread(ProgramState *state) {
             break;
         }
 
+        // if c = h, j, k or l we pan the viewport a quarter of the canvas
+        // left, down, up or right
+        if (c == 'h' || c == 'j' || c == 'k' || c == 'l') {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            int64_t scale = int64_t(1) << state->zoom;
+            auto [pixels_x, pixels_y] = canvas_pixels(state->render_mode, state->canvas.get_width(),
+                                                      state->canvas.get_height());
+            int64_t step_x = std::max<int64_t>(1, pixels_x / 4) * scale;
+            int64_t step_y = std::max<int64_t>(1, pixels_y / 4) * scale;
+            if (c == 'h') state->view_x -= step_x;
+            if (c == 'l') state->view_x += step_x;
+            if (c == 'k') state->view_y -= step_y;
+            if (c == 'j') state->view_y += step_y;
+            continue;
+        }
+
+        // if c = + or - we zoom in or out by a factor of two around the
+        // center of the canvas, keeping the view on whole pixels
+        if (c == '+' || c == '=' || c == '-') {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            int zoom = std::clamp(state->zoom + (c == '-' ? 1 : -1), 0, max_zoom);
+            auto [pixels_x, pixels_y] = canvas_pixels(state->render_mode, state->canvas.get_width(),
+                                                      state->canvas.get_height());
+            int64_t old_scale = int64_t(1) << state->zoom;
+            int64_t new_scale = int64_t(1) << zoom;
+            int64_t center_x = state->view_x + pixels_x * old_scale / 2;
+            int64_t center_y = state->view_y + pixels_y * old_scale / 2;
+            state->view_x = (center_x - pixels_x * new_scale / 2) & ~(new_scale - 1);
+            state->view_y = (center_y - pixels_y * new_scale / 2) & ~(new_scale - 1);
+            state->zoom = zoom;
+            continue;
+        }
+
+        // if c = m we show or hide the metrics overlay
+        if (c == 'm') {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->show_metrics = !state->show_metrics;
+            continue;
+        }
+
+        // if c = v we switch to the next render mode
+        if (c == 'v') {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (state->render_mode == RenderMode::blocks) {
+                state->render_mode = RenderMode::half;
+            } else if (state->render_mode == RenderMode::half) {
+                state->render_mode = RenderMode::braille;
+            } else {
+                state->render_mode = RenderMode::blocks;
+            }
+            continue;
+        }
+
+        // if c = c we save a checkpoint without pausing the simulation,
+        // unless the pattern can leave the area a checkpoint holds
+        if (c == 'c') {
+            if (state->engine->stays_in_bounds()) {
+                request_checkpoint(state);
+            }
+            continue;
+        }
+
         // if c = f or u or r we adjust certain parameters
         if (c == 'f' || c == 'u' || c == 'r') {
             {
@@ -130,8 +860,10 @@ void input_thread(ProgramState *state) {
                 write(1, "Enter new value: ", 17);
                 std::cin >> val;
 
-                // handle if input fails or is invalid
-                if (std::cin.fail() || val <= 0) {
+                // handle if input fails or is invalid. a simulation rate of
+                // 0 steps as fast as possible
+                bool unsupported = (c == 'r') && !std::cin.fail() && !state->engine->supports_rule(val);
+                if (std::cin.fail() || val < 0 || (val == 0 && c != 'u') || unsupported) {
 
                     if (std::cin.eof()){ 
                         break;  // ensure end of file
@@ -140,6 +872,9 @@ void input_thread(ProgramState *state) {
                     //clear faulty input and ask again
                     std::cin.clear();
                     std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+                    if (unsupported) {
+                        write(1, "The engine can't run rules where tiles with no neighbors are born\n", 66);
+                    }
                     write(1, "Invalid input: Try again\n", 25);
 
                 } else {
@@ -168,38 +903,296 @@ void input_thread(ProgramState *state) {
 // main function
 int main(int argc, char *argv[]) {
 
-    // handle too many/no arguements
-    if (argc != 2) {
+    // parse options and the path of the input file
+    bool headless_mode = false;
+    long generations = 1000;
+    std::string engine_name = "grid";
+    std::string topology_name = "bounded";
+    RenderMode render_mode = RenderMode::blocks;
+    int step_exp = 0;
+    int time_block = 1;
+    int workers = std::max(1u, std::thread::hardware_concurrency());
+    int rule = 6152;
+    bool rule_given = false;
+    CycleAction on_cycle = CycleAction::report;
+    int frame_rate = 1;
+    int sim_rate = 1;
+    std::string file_path;
+    std::string checkpoint_path;
+    std::string resume_path;
+    bool verify = true;
+    std::string metrics_path;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--headless") {
+            headless_mode = true;
+        } else if (arg == "--generations" && (i + 1 < argc)) {
+            generations = std::atol(argv[++i]);
+            if (generations <= 0) {
+                write(2, "Error: --generations must be positive\n", 38);
+                return 1;
+            }
+        } else if (arg == "--frame-rate" && (i + 1 < argc)) {
+            frame_rate = std::atoi(argv[++i]);
+            if (frame_rate <= 0) {
+                write(2, "Error: --frame-rate must be positive\n", 37);
+                return 1;
+            }
+        } else if (arg == "--sim-rate" && (i + 1 < argc)) {
+            sim_rate = std::atoi(argv[++i]);
+            if (sim_rate < 0) {
+                write(2, "Error: --sim-rate must not be negative\n", 39);
+                return 1;
+            }
+        } else if (arg == "--engine" && (i + 1 < argc)) {
+            engine_name = argv[++i];
+        } else if (arg == "--render" && (i + 1 < argc)) {
+            std::string mode = argv[++i];
+            if (mode == "blocks") {
+                render_mode = RenderMode::blocks;
+            } else if (mode == "half") {
+                render_mode = RenderMode::half;
+            } else if (mode == "braille") {
+                render_mode = RenderMode::braille;
+            } else {
+                write(2, "Error: Unknown render mode\n", 27);
+                return 1;
+            }
+        } else if (arg == "--topology" && (i + 1 < argc)) {
+            topology_name = argv[++i];
+        } else if (arg == "--step-exp" && (i + 1 < argc)) {
+            step_exp = std::atoi(argv[++i]);
+            if (step_exp < 0 || step_exp > 48) {
+                write(2, "Error: --step-exp must be between 0 and 48\n", 43);
+                return 1;
+            }
+        } else if (arg == "--time-block" && (i + 1 < argc)) {
+            time_block = std::atoi(argv[++i]);
+            if (time_block < 1 || time_block > 64) {
+                write(2, "Error: --time-block must be between 1 and 64\n", 45);
+                return 1;
+            }
+        } else if (arg == "--workers" && (i + 1 < argc)) {
+            workers = std::atoi(argv[++i]);
+            if (workers <= 0) {
+                write(2, "Error: --workers must be positive\n", 34);
+                return 1;
+            }
+        } else if (arg == "--on-cycle" && (i + 1 < argc)) {
+            std::string action = argv[++i];
+            if (action == "report") {
+                on_cycle = CycleAction::report;
+            } else if (action == "stop") {
+                on_cycle = CycleAction::stop;
+            } else if (action == "skip") {
+                on_cycle = CycleAction::skip;
+            } else {
+                write(2, "Error: --on-cycle must be report, stop, or skip\n", 48);
+                return 1;
+            }
+        } else if (arg == "--rule" && (i + 1 < argc)) {
+            // accept either a rule string like B3/S23 or a rule integer
+            std::string text = argv[++i];
+            rule = parse_rule(text);
+            rule = (rule > 0) ? rule : std::atoi(text.c_str());
+            rule_given = true;
+            if (rule <= 0) {
+                write(2, "Error: --rule must be positive\n", 31);
+                return 1;
+            }
+        } else if (arg == "--kernel" && (i + 1 < argc)) {
+            if (!set_kernel(argv[++i])) {
+                write(2, "Error: Unknown or unsupported kernel\n", 37);
+                return 1;
+            }
+        } else if (arg == "--checkpoint" && (i + 1 < argc)) {
+            checkpoint_path = argv[++i];
+        } else if (arg == "--resume" && (i + 1 < argc)) {
+            resume_path = argv[++i];
+        } else if (arg == "--no-verify") {
+            verify = false;
+        } else if (arg == "--metrics-file" && (i + 1 < argc)) {
+            metrics_path = argv[++i];
+        } else if (arg == "--self-check") {
+            return kernel_self_check(std::cout) ? 0 : 1;
+        } else if (arg.starts_with("--") || !file_path.empty()) {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--headless] [--generations N] [--rule R] [--engine grid|tiled|plane|hashlife|strips]"
+                         " [--frame-rate N] [--sim-rate N] [--on-cycle report|stop|skip]"
+                         " [--topology bounded|torus|klein] [--step-exp K] [--time-block K] [--workers N]"
+                         " [--kernel scalar|sse2|avx2|avx512] [--render blocks|half|braille]"
+                         " [--checkpoint FILE] [--metrics-file FILE] <input_file | --resume FILE [--no-verify]>\n"
+                      << "       " << argv[0] << " --self-check\n";
+            return 1;
+        } else {
+            file_path = arg;
+        }
+    }
+
+    // handle no arguements, or both a pattern and a checkpoint
+    if (file_path.empty() == resume_path.empty()) {
         write(2, "Invalid argument number: Please only pass 1 argument\n", 53);
         return 1;
     }
 
-    //open file
-    std::string file_path = argv[1];
-    std::ifstream file(file_path);
+    // load the pattern or checkpoint, timing how long the file takes to read
+    auto load_start = std::chrono::steady_clock::now();
+    // a rule given on the command line wins over one named by the file
+    Grid* grid;
+    uint64_t start_generation = 0;
+    try {
+        int file_rule = rule;
+        if (!resume_path.empty()) {
+            grid = read_checkpoint(resume_path, start_generation, file_rule, verify);
+            file_path = resume_path;
+        } else {
+            grid = load_pattern(file_path, file_rule);
+        }
+        rule = rule_given ? rule : file_rule;
+    } catch (std::runtime_error &error) {
+        std::cerr << "Error: " << error.what() << '\n';
+        return 1;
+    }
+    auto load_end = std::chrono::steady_clock::now();
+
+    // report load throughput when benchmarking
+    if (headless_mode) {
+        double load_seconds = std::chrono::duration<double>(load_end - load_start).count();
+        double load_mb = std::filesystem::file_size(file_path) / 1e6;
+        std::cout << "load:            " << load_mb << " MB in " << load_seconds
+                  << " s (" << load_mb / load_seconds << " MB/s)\n";
+    }
+
+    // only the grid engine can wrap its edges around
+    Topology topology;
+    if (topology_name == "bounded") {
+        topology = Topology::bounded;
+    } else if (topology_name == "torus") {
+        topology = Topology::torus;
+    } else if (topology_name == "klein") {
+        topology = Topology::klein;
+    } else {
+        write(2, "Error: Unknown topology\n", 24);
+        delete grid;
+        return 1;
+    }
+    if (topology != Topology::bounded && engine_name != "grid") {
+        write(2, "Error: Only the grid engine supports wrapping topologies\n", 57);
+        delete grid;
+        return 1;
+    }
+
+    // only the grid engine steps in blocks of generations, and only when
+    // its edges are dead
+    if (time_block > 1 && (engine_name != "grid" || topology != Topology::bounded)) {
+        write(2, "Error: --time-block needs the grid engine on a bounded grid\n", 60);
+        delete grid;
+        return 1;
+    }
+
+    // hand the pattern to the chosen engine
+    Engine* engine;
+    if (engine_name == "grid") {
+        engine = new GridEngine(grid, start_generation, topology, time_block);
+    } else if (engine_name == "tiled") {
+        engine = new TiledEngine(*grid, start_generation);
+        delete grid;
+    } else if (engine_name == "plane") {
+        engine = new PlaneEngine(*grid, start_generation);
+        delete grid;
+    } else if (engine_name == "hashlife") {
+        engine = new HashLife(*grid, step_exp, hashlife_max_nodes, start_generation);
+        delete grid;
+    } else if (engine_name == "strips") {
+        // the workers are forked here, before any other thread starts
+        try {
+            engine = new StripEngine(*grid, workers, start_generation);
+        } catch (std::runtime_error &error) {
+            std::cerr << "Error: " << error.what() << '\n';
+            delete grid;
+            return 1;
+        }
+        delete grid;
+    } else {
+        write(2, "Error: Unknown engine\n", 22);
+        delete grid;
+        return 1;
+    }
+
+    // engines on an unbounded plane can't fill it with births from nothing
+    if (!engine->supports_rule(rule)) {
+        write(2, "Error: The engine can't run rules where tiles with no neighbors are born\n", 73);
+        delete engine;
+        return 1;
+    }
 
-    // ensure file opens properly
-    if (!file.is_open()) {
-        write(2, "Error: Cannot open file\n", 24);
+    // checkpoints only hold the initial area, so engines whose pattern can
+    // leave it can't save them
+    if (!checkpoint_path.empty() && !engine->stays_in_bounds()) {
+        write(2, "Error: --checkpoint needs the grid, tiled, or strips engine\n", 60);
+        delete engine;
         return 1;
     }
 
-    // Dynamically allocate grids to prevent memory leaks
-    Grid* grid_a = new Grid(file_path);
-    Grid* grid_b = new Grid(grid_a->get_width(), grid_a->get_height());
+    // checkpoints go to the --checkpoint file, and are also written on
+    // exit if one was given
+    CheckpointWriter checkpoints;
+    bool checkpoint_on_exit = !checkpoint_path.empty();
+    if (checkpoint_path.empty()) {
+        checkpoint_path = "p3.ckpt";
+    }
+
+    // frames are handed from the update thread to the draw thread
+    FrameExchange frames;
 
     // set current program state
     ProgramState state{
-        .rule = 6152,
-        .frame_rate = 1,
-        .sim_rate = 1,
-        .prev = grid_a,
-        .next = grid_b,
-        .canvas = tui::Canvas(grid_a->get_width() * 2, grid_a->get_height()),
+        .rule = rule,
+        .generation = engine->get_generation(),
+        .cycles = CycleDetector(cycle_history),
+        .on_cycle = on_cycle,
+        .cycle_rule = rule,
+        .cycle_step = 1,
+        .cycle_frames = {},
+        .frame_rate = frame_rate,
+        .sim_rate = sim_rate,
+        .frame_pacer = Pacer(frame_rate, frame_max_lag),
+        .sim_pacer = Pacer(sim_rate, sim_max_lag),
+        .step_time = Histogram(),
+        .render_time = Histogram(),
+        .show_metrics = false,
+        .engine = engine,
+        .view_x = 0,
+        .view_y = 0,
+        .zoom = 0,
+        .render_mode = render_mode,
+        .checkpoints = &checkpoints,
+        .checkpoint_path = checkpoint_path,
+        .checkpoint_requested = false,
+        .frames = headless_mode ? nullptr : &frames,
+        .canvas = tui::Canvas(0, 0),
+        .mutex = {},
         .running = true,
         .paused = false,
+        .cond = {},
+        .error = "",
     };
 
+    // the starting generation is the first one a cycle can return to
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        watch_cycles(&state, 0);
+    }
+
+    // skip the terminal entirely when benchmarking
+    if (headless_mode) {
+        int status = headless(&state, generations);
+        status |= save_metrics(&state, metrics_path);
+        status |= finish_checkpoints(&state, checkpoint_on_exit);
+        delete engine;
+        return status;
+    }
+
     // start simulation threads
     std::thread dthread(draw, &state);
     std::thread uthread(update, &state);
@@ -210,12 +1203,32 @@ int main(int argc, char *argv[]) {
     uthread.join();
     ithread.join();
 
-    // hide canvas before exit
+    // hide canvas before exit, and report how the frames were used
     state.canvas.hide();
+    std::cout << "frames: " << frames.get_published() << " published, "
+              << frames.get_dropped() << " dropped before drawing, "
+              << frames.get_repeated() << " drawn again with nothing newer\n"
+              << "frame rate: " << state.frame_pacer.get_achieved() << "/s achieved, "
+              << state.frame_rate << "/s requested, "
+              << state.frame_pacer.get_skipped() << " frames skipped\n"
+              << "sim rate: " << state.sim_pacer.get_achieved() << "/s achieved, ";
+    if (state.sim_rate == 0) {
+        std::cout << "unlimited requested\n";
+    } else {
+        std::cout << state.sim_rate << "/s requested, "
+                  << state.sim_pacer.get_skipped() << " steps skipped\n";
+    }
+    std::cout << "cycle: " << describe_cycle(&state) << '\n';
+    int status = 0;
+    if (!state.error.empty()) {
+        std::cerr << "Error: " << state.error << '\n';
+        status = 1;
+    }
+    status |= save_metrics(&state, metrics_path);
+    status |= finish_checkpoints(&state, checkpoint_on_exit);
 
     // Free allocated memory
-    delete grid_a;
-    delete grid_b;
+    delete engine;
 
-    return 0;
+    return status;
 }
@@ -0,0 +1,91 @@
+#include <algorithm>
+#include <thread>
+#include "pacer.h"
+
+// desc : Initializes the pacer to run at `rate` ticks per second, or as
+//        fast as possible for a rate of 0, letting the loop fall up to
+//        `max_lag` periods behind before skipping deadlines
+// pre  : `rate` must not be negative, and `max_lag` must be positive
+// post : None, aside from description
+Pacer::Pacer(int rate, int max_lag)
+    : max_lag(max_lag)
+    , rate(rate)
+    , ticks(0)
+    , skipped(0)
+    , window_ticks(0)
+    , achieved(0)
+{
+    restart();
+}
+
+// desc : Records a tick, measures the achieved rate once a second, then
+//        sleeps until the next deadline, skipping deadlines that are
+//        more than `max_lag` periods in the past
+// pre  : `rate` must not be negative
+// post : None, aside from description
+void Pacer::tick(int rate) {
+    Clock::time_point now = Clock::now();
+    ticks.fetch_add(1, std::memory_order_relaxed);
+    window_ticks++;
+    std::chrono::duration<double> window = now - window_start;
+    if (window.count() >= 1.0) {
+        achieved.store(window_ticks / window.count(), std::memory_order_relaxed);
+        window_start = now;
+        window_ticks = 0;
+    }
+
+    // A new rate is measured from now rather than from old deadlines
+    if (rate != this->rate) {
+        this->rate = rate;
+        deadline   = now;
+    }
+    if (rate == 0) {
+        deadline = now;
+        return;
+    }
+
+    // Periods are kept in floating point, so rates above 1000 per second
+    // don't round down to nothing
+    auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / rate));
+    period = std::max(period, Clock::duration(1));
+    deadline += period;
+    if (now - deadline > period * max_lag) {
+        uint64_t missed = (now - deadline) / period - max_lag;
+        skipped.fetch_add(missed, std::memory_order_relaxed);
+        deadline += period * missed;
+    }
+    std::this_thread::sleep_until(deadline);
+}
+
+// desc : Forgets any lag, so that the next tick is due a full period from
+//        now
+// pre  : None
+// post : None, aside from description
+void Pacer::restart() {
+    deadline     = Clock::now();
+    window_start = deadline;
+    window_ticks = 0;
+}
+
+// desc : Returns the number of ticks per second achieved over the last
+//        complete measuring window
+// pre  : None
+// post : None, aside from description
+double Pacer::get_achieved() {
+    return achieved.load(std::memory_order_relaxed);
+}
+
+// desc : Returns the number of ticks so far
+// pre  : None
+// post : None, aside from description
+uint64_t Pacer::get_ticks() {
+    return ticks.load(std::memory_order_relaxed);
+}
+
+// desc : Returns the number of deadlines skipped because the loop fell
+//        more than `max_lag` periods behind
+// pre  : None
+// post : None, aside from description
+uint64_t Pacer::get_skipped() {
+    return skipped.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,83 @@
+#ifndef PACER
+#define PACER
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+///////////////////////////////////////////////////////////
+// Paces a loop to a requested number of ticks per second.
+//
+// Each tick is given an absolute deadline on the steady
+// clock, one period after the last, and the loop sleeps
+// until it. Time spent doing work is therefore absorbed into
+// the period instead of added to it, and rounding never
+// accumulates. When the loop falls behind, ticks run back to
+// back to catch up, but never more than `max_lag` periods'
+// worth: deadlines further in the past are skipped instead.
+///////////////////////////////////////////////////////////
+class Pacer {
+
+    using Clock = std::chrono::steady_clock;
+
+    // The number of periods the loop may fall behind before the
+    // deadlines it missed are skipped
+    int               max_lag;
+
+    // The requested rate, in ticks per second, with 0 meaning as fast
+    // as possible, and the deadline of the next tick
+    int               rate;
+    Clock::time_point deadline;
+
+    // The number of ticks so far, and the number of deadlines skipped
+    // because the loop fell too far behind
+    std::atomic<uint64_t> ticks;
+    std::atomic<uint64_t> skipped;
+
+    // The start of the current measuring window and the ticks within it,
+    // and the rate measured over the last complete window
+    Clock::time_point   window_start;
+    uint64_t            window_ticks;
+    std::atomic<double> achieved;
+
+    public:
+
+    // desc : Initializes the pacer to run at `rate` ticks per second, or as
+    //        fast as possible for a rate of 0, letting the loop fall up to
+    //        `max_lag` periods behind before skipping deadlines
+    // pre  : `rate` must not be negative, and `max_lag` must be positive
+    // post : None, aside from description
+    Pacer(int rate, int max_lag);
+
+    // desc : Records a tick, then sleeps until the deadline of the next
+    //        one. A change of `rate` since the last call takes effect from
+    //        now, without catching up on or skipping anything.
+    // pre  : `rate` must not be negative
+    // post : None, aside from description
+    void tick(int rate);
+
+    // desc : Forgets any lag, so that the next tick is due a full period
+    //        from now. Used after the loop was deliberately held up.
+    // pre  : None
+    // post : None, aside from description
+    void restart();
+
+    // desc : Returns the number of ticks per second achieved over the last
+    //        second or so
+    // pre  : None
+    // post : None, aside from description
+    double get_achieved();
+
+    // desc : Returns the number of ticks so far
+    // pre  : None
+    // post : None, aside from description
+    uint64_t get_ticks();
+
+    // desc : Returns the number of deadlines skipped because the loop fell
+    //        more than `max_lag` periods behind
+    // pre  : None
+    // post : None, aside from description
+    uint64_t get_skipped();
+};
+
+#endif //PACER
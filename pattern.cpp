@@ -0,0 +1,405 @@
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "pattern.h"
+
+// Reads a file through a fixed-size buffer, one character at a time
+class Reader {
+
+    int    fd;
+    char   buffer[1 << 16];
+    size_t position;
+    size_t length;
+
+    public:
+
+    // desc : Opens the input file for reading
+    // pre  : None
+    // post : Throws a std::runtime_error if the file can't be opened
+    Reader(std::string file_path)
+        : fd(open(file_path.c_str(), O_RDONLY))
+        , position(0)
+        , length(0)
+    {
+        if (fd < 0) {
+            throw std::runtime_error("Cannot open file");
+        }
+    }
+
+    // desc : Closes the file
+    // pre  : None
+    // post : None, aside from description
+    ~Reader() {
+        close(fd);
+    }
+
+    // desc : Returns the next character of the file, or -1 at its end
+    // pre  : None
+    // post : Throws a std::runtime_error if reading fails
+    int get() {
+        if (position == length) {
+            ssize_t count = read(fd, buffer, sizeof(buffer));
+            if (count < 0) {
+                throw std::runtime_error("Cannot read file");
+            }
+            position = 0;
+            length   = count;
+            if (length == 0) {
+                return -1;
+            }
+        }
+        return (unsigned char) buffer[position++];
+    }
+
+    // desc : Reads the next line of the file into `line`, without its
+    //        line ending, returning false if the file has ended
+    // pre  : None
+    // post : None, aside from description
+    bool get_line(std::string &line) {
+        line.clear();
+        int c = get();
+        if (c < 0) {
+            return false;
+        }
+        while ((c >= 0) && (c != '\n')) {
+            if (c != '\r') {
+                line += (char) c;
+            }
+            c = get();
+        }
+        return true;
+    }
+};
+
+// desc : Returns whether `text` ends with `suffix`
+// pre  : None
+// post : None, aside from description
+static bool ends_with(std::string const &text, std::string const &suffix) {
+    return (text.size() >= suffix.size())
+        && (text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0);
+}
+
+// desc : Marks `length` tiles of row `y` as alive, starting at column `x`,
+//        a word at a time. Tiles past the edges of the grid are ignored.
+// pre  : None
+// post : None, aside from description
+static void set_run(Grid &grid, int64_t x, int64_t y, int64_t length) {
+    if ((y < 0) || (y >= grid.get_height()) || (x >= grid.get_width())) {
+        return;
+    }
+    int64_t end = std::min<int64_t>(x + length, grid.get_width());
+    uint64_t *words = grid.row(y);
+    while (x < end) {
+        int64_t  bit   = x & 63;
+        int64_t  count = std::min<int64_t>(64 - bit, end - x);
+        uint64_t mask  = (count == 64) ? ~uint64_t(0) : ((uint64_t(1) << count) - 1) << bit;
+        words[x >> 6] |= mask;
+        x += count;
+    }
+}
+
+// desc : Converts a rule written as "B3/S23" (any case, with or without the
+//        slash) or in the older survival-first "23/3" form into the rule
+//        integer used by the engines, in which bit (alive*9)+count is set
+//        when a tile with `count` live neighbors is alive next generation.
+//        Anything after a ':' (such as a topology suffix) is ignored.
+//        Returns -1 if the text isn't a valid rule.
+// pre  : None
+// post : None, aside from description
+int parse_rule(std::string text) {
+    text = text.substr(0, text.find(':'));
+    std::string clean;
+    for (char c : text) {
+        if (!std::isspace((unsigned char) c)) {
+            clean += std::toupper((unsigned char) c);
+        }
+    }
+
+    // In "B3/S23" form the letters say which digits are which. In "23/3"
+    // form, survival comes first.
+    bool lettered = clean.find_first_of("BS") != std::string::npos;
+    int  offset   = lettered ? -1 : 9;
+    bool seen_slash = false;
+    int  rule = 0;
+    for (char c : clean) {
+        if (c == 'B') {
+            offset = 0;
+        } else if (c == 'S') {
+            offset = 9;
+        } else if (c == '/') {
+            if (!lettered) {
+                if (seen_slash) {
+                    return -1;
+                }
+                offset = 0;
+            }
+            seen_slash = true;
+        } else if ((c >= '0') && (c <= '8') && (offset >= 0)) {
+            rule |= 1 << (offset + (c - '0'));
+        } else {
+            return -1;
+        }
+    }
+    if (clean.empty() || (!lettered && !seen_slash)) {
+        return -1;
+    }
+    return rule;
+}
+
+// desc : Loads a run-length encoded pattern. Comment lines starting with
+//        '#' are skipped, except for "#r" lines naming a rule, until the
+//        "x = W, y = H, rule = R" header, after which the cells are decoded
+//        as a stream of runs: 'b' for dead tiles, any other letter for live
+//        tiles, '$' to end rows, and '!' to end the pattern.
+// pre  : None
+// post : Throws a std::runtime_error if the file is malformed
+static Grid *load_rle(std::string file_path, int &rule) {
+    Reader reader(file_path);
+
+    // Find the header, which sizes the grid
+    std::string line;
+    while (true) {
+        if (!reader.get_line(line)) {
+            throw std::runtime_error("RLE file has no header");
+        }
+        if ((line.size() >= 2) && (line[0] == '#') && (line[1] == 'r')) {
+            int parsed = parse_rule(line.substr(2));
+            rule = (parsed > 0) ? parsed : rule;
+        } else if ((line.find_first_not_of(" \t") != std::string::npos) && (line[0] != '#')) {
+            break;
+        }
+    }
+
+    int64_t width  = -1;
+    int64_t height = -1;
+    size_t  start  = 0;
+    while (start < line.size()) {
+        size_t end = line.find(',', start);
+        end = (end == std::string::npos) ? line.size() : end;
+        std::string field = line.substr(start, end - start);
+        size_t equals = field.find('=');
+        if (equals != std::string::npos) {
+            std::string key   = field.substr(0, equals);
+            std::string value = field.substr(equals + 1);
+            key.erase(std::remove_if(key.begin(), key.end(), ::isspace), key.end());
+            if (key == "x") {
+                width = std::atoll(value.c_str());
+            } else if (key == "y") {
+                height = std::atoll(value.c_str());
+            } else if (key == "rule") {
+                int parsed = parse_rule(value);
+                rule = (parsed > 0) ? parsed : rule;
+            }
+        }
+        start = end + 1;
+    }
+    if ((width < 0) || (height < 0) || (width > INT32_MAX - 64) || (height > INT32_MAX - 2)) {
+        throw std::runtime_error("Malformed RLE header");
+    }
+
+    Grid *grid = new Grid(width, height);
+
+    // Decode runs until '!' or the end of the file
+    int64_t x = 0;
+    int64_t y = 0;
+    int64_t count = 0;
+    int c;
+    while (((c = reader.get()) >= 0) && (c != '!')) {
+        if ((c >= '0') && (c <= '9')) {
+            count = count * 10 + (c - '0');
+            if (count > INT32_MAX) {
+                delete grid;
+                throw std::runtime_error("Malformed RLE run length");
+            }
+            continue;
+        }
+        int64_t run = (count == 0) ? 1 : count;
+        count = 0;
+        if (c == '$') {
+            y += run;
+            x  = 0;
+        } else if (c == 'b') {
+            x += run;
+        } else if (std::isalpha(c)) {
+            set_run(*grid, x, y, run);
+            x += run;
+        } else if (c == '#') {
+            // Skip comments that trail the pattern
+            while (((c = reader.get()) >= 0) && (c != '\n')) {}
+        }
+    }
+    return grid;
+}
+
+// A node read from a Macrocell file: either a level 3 leaf of 8x8 tiles,
+// or a square of four earlier nodes
+struct McNode {
+    int      level;
+    // The indices of the quadrants (nw, ne, sw, se), where 0 means empty
+    uint32_t children[4];
+    // For leaves, bit (8*y+x) holds the tile at (x,y)
+    uint64_t bits;
+    // The bounding box of the node's live tiles, relative to its top-left
+    // corner, which is empty if min_x > max_x
+    int64_t  min_x;
+    int64_t  min_y;
+    int64_t  max_x;
+    int64_t  max_y;
+};
+
+// desc : Marks the live tiles of the input Macrocell node as alive in
+//        `grid`, where (x,y) is the position of the node's top-left
+//        corner in the grid
+// pre  : None
+// post : None, aside from description
+static void rasterize(std::vector<McNode> &nodes, uint32_t index,
+                      Grid &grid, int64_t x, int64_t y) {
+    McNode &node = nodes[index];
+    if ((index == 0) || (node.min_x > node.max_x)) {
+        return;
+    }
+    if (node.level == 3) {
+        for (int i=0; i<64; i++) {
+            if ((node.bits >> i) & 1) {
+                grid.set_tile(x + (i & 7), y + (i >> 3), true);
+            }
+        }
+        return;
+    }
+    int64_t half = int64_t(1) << (node.level - 1);
+    rasterize(nodes, node.children[0], grid, x,        y       );
+    rasterize(nodes, node.children[1], grid, x + half, y       );
+    rasterize(nodes, node.children[2], grid, x,        y + half);
+    rasterize(nodes, node.children[3], grid, x + half, y + half);
+}
+
+// desc : Loads a Macrocell pattern, a quadtree written bottom-up with one
+//        node per line. Leaf lines describe 8x8 squares with '.' for dead
+//        tiles, '*' for live tiles and '$' to end rows. Other lines are
+//        "level nw ne sw se", referring to earlier nodes by their 1-based
+//        position (0 being empty). The last node is the root. Only the
+//        bounding box of the root's live tiles becomes the grid.
+// pre  : None
+// post : Throws a std::runtime_error if the file is malformed
+static Grid *load_macrocell(std::string file_path, int &rule) {
+    Reader reader(file_path);
+
+    std::string line;
+    if (!reader.get_line(line) || (line.rfind("[M2]", 0) != 0)) {
+        throw std::runtime_error("Macrocell file has no [M2] header");
+    }
+
+    std::vector<McNode> nodes(1, McNode{ 0, {0,0,0,0}, 0, 1, 1, 0, 0 });
+    while (reader.get_line(line)) {
+        if (line.empty()) {
+            continue;
+        }
+        if (line[0] == '#') {
+            if ((line.size() >= 2) && (line[1] == 'R')) {
+                int parsed = parse_rule(line.substr(2));
+                rule = (parsed > 0) ? parsed : rule;
+            }
+            continue;
+        }
+
+        McNode node = { 3, {0,0,0,0}, 0, 8, 8, -1, -1 };
+        if ((line[0] == '.') || (line[0] == '*') || (line[0] == '$')) {
+            int x = 0;
+            int y = 0;
+            for (char c : line) {
+                if (c == '$') {
+                    x = 0;
+                    y++;
+                } else if ((c == '*') && (x < 8) && (y < 8)) {
+                    node.bits |= uint64_t(1) << (8*y + x);
+                    node.min_x = std::min<int64_t>(node.min_x, x);
+                    node.min_y = std::min<int64_t>(node.min_y, y);
+                    node.max_x = std::max<int64_t>(node.max_x, x);
+                    node.max_y = std::max<int64_t>(node.max_y, y);
+                    x++;
+                } else {
+                    x++;
+                }
+            }
+        } else {
+            long long values[5];
+            if (std::sscanf(line.c_str(), "%lld %lld %lld %lld %lld", &values[0],
+                            &values[1], &values[2], &values[3], &values[4]) != 5) {
+                throw std::runtime_error("Malformed Macrocell node");
+            }
+            node.level = values[0];
+            if ((node.level <= 3) || (node.level > 62)) {
+                throw std::runtime_error("Unsupported Macrocell node level");
+            }
+            int64_t half = int64_t(1) << (node.level - 1);
+            node.min_x = node.min_y = INT64_MAX;
+            node.max_x = node.max_y = INT64_MIN;
+            for (int q=0; q<4; q++) {
+                if ((values[q+1] < 0) || (values[q+1] >= (long long) nodes.size())) {
+                    throw std::runtime_error("Macrocell node refers to a later node");
+                }
+                node.children[q] = values[q+1];
+                McNode &child = nodes[node.children[q]];
+                if ((node.children[q] == 0) || (child.min_x > child.max_x)) {
+                    continue;
+                }
+                if (child.level != node.level - 1) {
+                    throw std::runtime_error("Macrocell node has children of the wrong level");
+                }
+                int64_t dx = (q & 1)  ? half : 0;
+                int64_t dy = (q >> 1) ? half : 0;
+                node.min_x = std::min(node.min_x, child.min_x + dx);
+                node.min_y = std::min(node.min_y, child.min_y + dy);
+                node.max_x = std::max(node.max_x, child.max_x + dx);
+                node.max_y = std::max(node.max_y, child.max_y + dy);
+            }
+        }
+        nodes.push_back(node);
+    }
+
+    if (nodes.size() < 2) {
+        throw std::runtime_error("Macrocell file has no nodes");
+    }
+    McNode &root = nodes.back();
+    if (root.min_x > root.max_x) {
+        return new Grid(0, 0);
+    }
+    int64_t width  = root.max_x - root.min_x + 1;
+    int64_t height = root.max_y - root.min_y + 1;
+    if ((width > INT32_MAX - 64) || (height > INT32_MAX - 2)) {
+        throw std::runtime_error("Macrocell pattern is too large for a grid");
+    }
+    Grid *grid = new Grid(width, height);
+    rasterize(nodes, nodes.size() - 1, *grid, -root.min_x, -root.min_y);
+    return grid;
+}
+
+// desc : Loads the pattern stored in the input file into a new grid,
+//        choosing a format based on the file's name and header
+// pre  : None
+// post : Throws a std::runtime_error if the file can't be read or is
+//        malformed. The caller owns the returned grid.
+Grid *load_pattern(std::string file_path, int &rule) {
+    if (ends_with(file_path, ".rle")) {
+        return load_rle(file_path, rule);
+    }
+    if (ends_with(file_path, ".mc")) {
+        return load_macrocell(file_path, rule);
+    }
+
+    // Macrocell files can also be recognized by their first line
+    char header[4] = {};
+    int fd = open(file_path.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        ssize_t count = read(fd, header, sizeof(header));
+        close(fd);
+        if ((count == 4) && (std::memcmp(header, "[M2]", 4) == 0)) {
+            return load_macrocell(file_path, rule);
+        }
+    }
+    return new Grid(file_path);
+}
@@ -0,0 +1,29 @@
+#ifndef PATTERN
+#define PATTERN
+
+#include <string>
+#include "grid.h"
+
+// desc : Loads the pattern stored in the input file into a new grid. Files
+//        ending in ".rle" are read as run-length encoded patterns, files
+//        ending in ".mc" or starting with "[M2]" as Macrocell patterns,
+//        and anything else as plain text (see `Grid(std::string)`). RLE
+//        and Macrocell files are parsed as a stream, a buffer at a time,
+//        straight into the grid's packed tiles. If the file names a rule
+//        that `parse_rule` understands, `rule` is set to it.
+// pre  : None
+// post : Throws a std::runtime_error if the file can't be read or is
+//        malformed. The caller owns the returned grid.
+Grid *load_pattern(std::string file_path, int &rule);
+
+// desc : Converts a rule written as "B3/S23" (any case, with or without the
+//        slash) or in the older survival-first "23/3" form into the rule
+//        integer used by the engines, in which bit (alive*9)+count is set
+//        when a tile with `count` live neighbors is alive next generation.
+//        Anything after a ':' (such as a topology suffix) is ignored.
+//        Returns -1 if the text isn't a valid rule.
+// pre  : None
+// post : None, aside from description
+int parse_rule(std::string text);
+
+#endif //PATTERN
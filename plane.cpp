@@ -0,0 +1,285 @@
+#include <algorithm>
+#include "plane.h"
+#include "kernel.h"
+
+// desc : Returns the hash map key of the chunk at the input chunk
+//        coordinates, packing the low 32 bits of each
+// pre  : None
+// post : None, aside from description
+uint64_t PlaneEngine::key(int64_t cx, int64_t cy) {
+    return (uint64_t(uint32_t(cx)) << 32) | uint32_t(cy);
+}
+
+// desc : Returns the chunk at the input chunk coordinates, or null if it
+//        doesn't exist
+// pre  : None
+// post : None, aside from description
+PlaneEngine::Chunk *PlaneEngine::find(int64_t cx, int64_t cy) {
+    auto found = chunks.find(key(cx, cy));
+    return (found == chunks.end()) ? nullptr : found->second;
+}
+
+// desc : Frees empty, unchanging chunks, allocates the neighbors that
+//        live edge tiles could spill into, and rebuilds the step order
+// pre  : No step may be in progress
+// post : None, aside from description
+void PlaneEngine::reshape() {
+    // Nothing can be born next to an empty chunk that didn't change, so
+    // it can go. Its neighbors stepping against nothing see the same
+    // dead tiles.
+    for (auto it = chunks.begin(); it != chunks.end(); ) {
+        Chunk *chunk = it->second;
+        bool empty = std::all_of(chunk->rows[current], chunk->rows[current] + chunk_size,
+                                 [](uint64_t row) { return row == 0; });
+        if (empty && !chunk->changed[current]) {
+            delete chunk;
+            it = chunks.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // Find every missing neighbor that live tiles on an edge or corner of
+    // a chunk could give birth into
+    std::vector<uint64_t> wanted;
+    for (auto &[k, chunk] : chunks) {
+        int64_t   cx   = int32_t(k >> 32);
+        int64_t   cy   = int32_t(k);
+        uint64_t *rows = chunk->rows[current];
+        // Bit 0 and bit 63 of this are set if any row has a live tile on
+        // the west or east edge
+        uint64_t  any  = 0;
+        for (int r=0; r<chunk_size; r++) {
+            any |= rows[r];
+        }
+        bool spills[3][3] = {};
+        spills[0][1] = rows[0] != 0;
+        spills[2][1] = rows[chunk_size-1] != 0;
+        spills[1][0] = (any & 1) != 0;
+        spills[1][2] = (any >> 63) != 0;
+        spills[0][0] = (rows[0] & 1) != 0;
+        spills[0][2] = (rows[0] >> 63) != 0;
+        spills[2][0] = (rows[chunk_size-1] & 1) != 0;
+        spills[2][2] = (rows[chunk_size-1] >> 63) != 0;
+        for (int dy=-1; dy<=1; dy++) {
+            for (int dx=-1; dx<=1; dx++) {
+                if (spills[dy+1][dx+1] && (find(cx+dx, cy+dy) == nullptr)) {
+                    wanted.push_back(key(cx+dx, cy+dy));
+                }
+            }
+        }
+    }
+    for (uint64_t k : wanted) {
+        if (chunks.count(k) == 0) {
+            chunks[k] = new Chunk{ {}, { true, true } };
+        }
+    }
+
+    // Resolve each chunk's neighbors once, so that steps never touch the
+    // hash map
+    order.clear();
+    neighbors.clear();
+    for (auto &[k, chunk] : chunks) {
+        int64_t cx = int32_t(k >> 32);
+        int64_t cy = int32_t(k);
+        order.push_back(chunk);
+        for (int dy=-1; dy<=1; dy++) {
+            for (int dx=-1; dx<=1; dx++) {
+                if ((dx != 0) || (dy != 0)) {
+                    neighbors.push_back(find(cx+dx, cy+dy));
+                }
+            }
+        }
+    }
+}
+
+// desc : Computes the next state of the chunk with the input index in
+//        `order` into its hidden half, unless neither it nor any of its
+//        neighbors changed in the visible generation. `Rule` is the rule
+//        as a compile-time constant, or -1 to use `rule`.
+// pre  : `reshape` must have run since the last commit
+// post : None, aside from description
+template<int Rule>
+void PlaneEngine::step_chunk(size_t index, int rule, bool force) {
+    Chunk  *chunk  = order[index];
+    Chunk **around = &neighbors[index * 8];
+    int     hidden = current ^ 1;
+
+    // The hidden half is two generations old, so if nothing nearby
+    // changed it already holds the right tiles
+    if (!force) {
+        bool active = chunk->changed[current];
+        for (int n=0; n<8; n++) {
+            active = active || (around[n] && around[n]->changed[current]);
+        }
+        if (!active) {
+            chunk->changed[hidden] = false;
+            return;
+        }
+    }
+
+    // Gather the rows above, through and below the chunk, from the
+    // chunks to its west, itself and its east. Bit 63 of the west words
+    // and bit 0 of the east words are the tiles bordering the chunk.
+    uint64_t west[chunk_size+2] = {};
+    uint64_t mid [chunk_size+2] = {};
+    uint64_t east[chunk_size+2] = {};
+    auto row = [this](Chunk *c, int r) { return c ? c->rows[current][r] : 0; };
+    west[0]            = row(around[0], chunk_size-1);
+    mid [0]            = row(around[1], chunk_size-1);
+    east[0]            = row(around[2], chunk_size-1);
+    west[chunk_size+1] = row(around[5], 0);
+    mid [chunk_size+1] = row(around[6], 0);
+    east[chunk_size+1] = row(around[7], 0);
+    for (int r=0; r<chunk_size; r++) {
+        west[r+1] = row(around[3], r);
+        mid [r+1] = chunk->rows[current][r];
+        east[r+1] = row(around[4], r);
+    }
+
+    bool changed = false;
+    for (int r=0; r<chunk_size; r++) {
+        uint64_t value = step_word<uint64_t>(
+            west[r  ], mid[r  ], east[r  ],
+            west[r+1], mid[r+1], east[r+1],
+            west[r+2], mid[r+2], east[r+2],
+            (Rule < 0) ? rule : Rule
+        );
+        changed = changed || (value != mid[r+1]);
+        chunk->rows[hidden][r] = value;
+    }
+    chunk->changed[hidden] = changed;
+}
+
+// desc : Creates an engine evolving the input grid's pattern on an
+//        unbounded plane, copying each non-empty word of the grid into
+//        the row of the chunk it falls in
+// pre  : None
+// post : None, aside from description
+PlaneEngine::PlaneEngine(Grid &grid, uint64_t generation)
+    : current(0)
+    , last_rule(-1)
+    , pool(0)
+    , generation(generation)
+    , width(grid.get_width())
+    , height(grid.get_height())
+{
+    for (int y=0; y<height; y++) {
+        uint64_t *words = grid.row(y);
+        for (int w=0; w<grid.get_words(); w++) {
+            if (words[w] == 0) {
+                continue;
+            }
+            Chunk *&chunk = chunks[key(w, y / chunk_size)];
+            if (chunk == nullptr) {
+                chunk = new Chunk{ {}, { true, true } };
+            }
+            chunk->rows[current][y % chunk_size] = words[w];
+        }
+    }
+    reshape();
+}
+
+// desc : Frees every chunk
+// pre  : None
+// post : None, aside from description
+PlaneEngine::~PlaneEngine() {
+    for (auto &[k, chunk] : chunks) {
+        delete chunk;
+    }
+}
+
+// desc : Steps every chunk whose neighborhood changed, spread across
+//        the worker pool
+// pre  : Any step computed previously must have been committed, and
+//        the engine must support `rule`
+// post : None, aside from description
+void PlaneEngine::step(int rule) {
+    bool force = rule != last_rule;
+    last_rule  = rule;
+
+    with_rule(rule, [this, rule, force](auto fixed) {
+        pool.run(order.size(), [this, rule, force](size_t index) {
+            step_chunk<decltype(fixed)::value>(index, rule, force);
+        });
+    });
+}
+
+// desc : Flips the freshly computed generation into view, then
+//        reshapes the set of chunks around it
+// pre  : `step` must have been called since the last commit
+// post : None, aside from description
+void PlaneEngine::commit() {
+    current ^= 1;
+    generation++;
+    reshape();
+}
+
+// desc : Returns whether or not the tile at the input coordinates is
+//        alive, anywhere on the plane
+// pre  : None
+// post : None, aside from description
+bool PlaneEngine::get_tile(int64_t x, int64_t y) {
+    // Arithmetic shifts round toward negative infinity, so tiles left of
+    // or above the origin land in negative chunks
+    Chunk *chunk = find(x >> 6, y >> 6);
+    return chunk && ((chunk->rows[current][y & 63] >> (x & 63)) & 1);
+}
+
+// desc : Returns the width of the initial pattern
+// pre  : None
+// post : None, aside from description
+int64_t PlaneEngine::get_width() {
+    return width;
+}
+
+// desc : Returns the height of the initial pattern
+// pre  : None
+// post : None, aside from description
+int64_t PlaneEngine::get_height() {
+    return height;
+}
+
+// desc : Returns the number of live tiles in the visible generation
+// pre  : None
+// post : None, aside from description
+uint64_t PlaneEngine::population() {
+    uint64_t total = 0;
+    for (auto &[k, chunk] : chunks) {
+        for (int r=0; r<chunk_size; r++) {
+            total += __builtin_popcountll(chunk->rows[current][r]);
+        }
+    }
+    return total;
+}
+
+// desc : Returns the number of committed generations
+// pre  : None
+// post : None, aside from description
+uint64_t PlaneEngine::get_generation() {
+    return generation;
+}
+
+// desc : Returns the engine's name, chunk count, and thread count
+// pre  : None
+// post : None, aside from description
+std::string PlaneEngine::describe() {
+    return "plane (" + std::to_string(chunks.size()) + " 64x64 chunks, "
+         + std::to_string(pool.size()) + " threads)";
+}
+
+// desc : Returns the pool the engine steps with
+// pre  : None
+// post : None, aside from description
+WorkerPool *PlaneEngine::get_pool() {
+    return &pool;
+}
+
+// desc : Reports whether the rule leaves dead tiles with no live
+//        neighbors dead, since births from nothing would fill the
+//        infinite empty plane with chunks
+// pre  : None
+// post : None, aside from description
+bool PlaneEngine::supports_rule(int rule) {
+    return (rule & 1) == 0;
+}
@@ -0,0 +1,131 @@
+#ifndef PLANE
+#define PLANE
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "engine.h"
+#include "grid.h"
+#include "pool.h"
+
+///////////////////////////////////////////////////////////
+// Steps a pattern on an unbounded plane, stored as 64x64
+// chunks in a hash map keyed by chunk coordinates. Only
+// chunks holding live tiles, or bordering chunks whose live
+// tiles reach their edge, exist at all, so patterns can
+// travel arbitrarily far and empty space costs nothing.
+//
+// Each chunk holds both the visible generation and the one
+// being computed, selected by a parity that flips on every
+// commit. Stepping only writes the hidden half of existing
+// chunks, so readers of the visible half never race with it.
+// Chunks are allocated and freed during `commit`, which runs
+// under the readers' lock.
+///////////////////////////////////////////////////////////
+class PlaneEngine : public Engine {
+
+    public:
+
+    // The side length of a chunk, in tiles
+    static const int chunk_size = 64;
+
+    private:
+
+    // A 64x64 square of tiles, in two generations
+    struct Chunk {
+        // rows[p][r] holds row r of the chunk in the generation with
+        // parity p, bit i being the tile at offset i
+        uint64_t rows[2][chunk_size];
+        // Whether any tile changed in the generation with parity p.
+        // New chunks count as changed, so their neighbors get stepped.
+        bool     changed[2];
+    };
+
+    // Spreads the bits of packed chunk coordinates across the hash
+    struct KeyHash {
+        size_t operator()(uint64_t key) const {
+            return (key * 0x9E3779B97F4A7C15ull) >> 16;
+        }
+    };
+
+    // Every chunk, keyed by `key(cx, cy)`
+    std::unordered_map<uint64_t, Chunk*, KeyHash> chunks;
+
+    // The chunks stepped by each task of a step, and the eight
+    // neighbors of each (null where there is no chunk), in the order
+    // nw, n, ne, w, e, sw, s, se. Rebuilt by every commit.
+    std::vector<Chunk*>  order;
+    std::vector<Chunk*>  neighbors;
+
+    // The parity of the visible generation
+    int                  current;
+
+    // The rule used for the last step. Changing rules steps every chunk.
+    int                  last_rule;
+
+    // Threads reused for every generation
+    WorkerPool           pool;
+
+    uint64_t             generation;
+
+    // The dimensions of the initial pattern
+    int64_t              width;
+    int64_t              height;
+
+    // desc : Returns the hash map key of the chunk at the input chunk
+    //        coordinates
+    // pre  : None
+    // post : None, aside from description
+    static uint64_t key(int64_t cx, int64_t cy);
+
+    // desc : Returns the chunk at the input chunk coordinates, or null
+    //        if it doesn't exist
+    // pre  : None
+    // post : None, aside from description
+    Chunk *find(int64_t cx, int64_t cy);
+
+    // desc : Frees every chunk that is empty and didn't change in the
+    //        visible generation, allocates the neighbors that live
+    //        tiles on the edge of a chunk could spill into, and rebuilds
+    //        `order` and `neighbors` for the next step
+    // pre  : No step may be in progress
+    // post : None, aside from description
+    void reshape();
+
+    // desc : Computes the next state of the chunk with the input index in
+    //        `order` into its hidden half, unless neither it nor any of
+    //        its neighbors changed in the visible generation. `Rule` is
+    //        the rule as a compile-time constant, or -1 to use `rule`.
+    // pre  : `reshape` must have run since the last commit
+    // post : None, aside from description
+    template<int Rule>
+    void step_chunk(size_t index, int rule, bool force);
+
+    public:
+
+    // desc : Creates an engine evolving the input grid's pattern on an
+    //        unbounded plane, with the grid's top-left corner at (0,0),
+    //        taking the grid to be generation `generation` of the pattern
+    // pre  : None
+    // post : None, aside from description
+    PlaneEngine(Grid &grid, uint64_t generation = 0);
+
+    // desc : Frees every chunk
+    // pre  : None
+    // post : None, aside from description
+    ~PlaneEngine();
+
+    void        step(int rule) override;
+    void        commit() override;
+    bool        get_tile(int64_t x, int64_t y) override;
+    int64_t     get_width() override;
+    int64_t     get_height() override;
+    uint64_t    population() override;
+    uint64_t    get_generation() override;
+    std::string describe() override;
+    WorkerPool *get_pool() override;
+    bool        supports_rule(int rule) override;
+};
+
+#endif //PLANE
@@ -0,0 +1,152 @@
+#include "pool.h"
+
+// desc : Returns the nanoseconds elapsed from `start` until now
+// pre  : None
+// post : None, aside from description
+static uint64_t nanoseconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start
+    ).count();
+}
+
+// desc : Claims and runs tasks of the current batch until none
+//        remain, adding the time it took to `busy_time`
+// pre  : A batch must be in progress
+// post : None, aside from description
+void WorkerPool::drain() {
+    auto   start = std::chrono::steady_clock::now();
+    size_t index;
+    while ((index = next_task.fetch_add(1)) < task_count) {
+        (*task)(index);
+    }
+    busy_time.fetch_add(nanoseconds_since(start), std::memory_order_relaxed);
+}
+
+// desc : The loop run by each background thread, waiting for
+//        batches and working on them until the pool is destroyed
+// pre  : None
+// post : None, aside from description
+void WorkerPool::work() {
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!stopping && (batch == seen)) {
+                start_cond.wait(lock);
+            }
+            if (stopping) {
+                return;
+            }
+            seen = batch;
+        }
+
+        drain();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            busy--;
+            if (busy == 0) {
+                done_cond.notify_one();
+            }
+        }
+    }
+}
+
+// desc : Starts a pool of the input size. A size of zero uses the
+//        hardware concurrency of the machine.
+// pre  : None
+// post : None, aside from description
+WorkerPool::WorkerPool(size_t thread_count)
+    : task(nullptr)
+    , task_count(0)
+    , next_task(0)
+    , busy(0)
+    , batch(0)
+    , stopping(false)
+    , busy_time(0)
+    , capacity_time(0)
+{
+    if (thread_count == 0) {
+        thread_count = std::thread::hardware_concurrency();
+    }
+    for (size_t i=1; i<thread_count; i++) {
+        workers.emplace_back(&WorkerPool::work, this);
+    }
+}
+
+// desc : Stops and joins all background threads
+// pre  : No batch may be in progress
+// post : None, aside from description
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    start_cond.notify_all();
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+// desc : Calls `task` once for each index in [0,count), spreading
+//        the calls across the pool, and returns once all calls have
+//        finished.
+// pre  : Must not be called concurrently, or from within a task
+// post : None, aside from description
+void WorkerPool::run(size_t count, std::function<void(size_t)> const& task) {
+    auto start = std::chrono::steady_clock::now();
+
+    // Small batches aren't worth waking anyone up for
+    if (workers.empty() || (count <= 1)) {
+        for (size_t i=0; i<count; i++) {
+            task(i);
+        }
+        uint64_t elapsed = nanoseconds_since(start);
+        busy_time.fetch_add(elapsed, std::memory_order_relaxed);
+        capacity_time.fetch_add(elapsed * size(), std::memory_order_relaxed);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->task       = &task;
+        this->task_count = count;
+        next_task        = 0;
+        busy             = workers.size();
+        batch++;
+    }
+    start_cond.notify_all();
+
+    // Help out rather than sitting idle
+    drain();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (busy != 0) {
+        done_cond.wait(lock);
+    }
+    capacity_time.fetch_add(nanoseconds_since(start) * size(), std::memory_order_relaxed);
+}
+
+// desc : Returns the number of threads that work on each batch,
+//        including the caller of `run`
+// pre  : None
+// post : None, aside from description
+size_t WorkerPool::size() {
+    return workers.size() + 1;
+}
+
+// desc : Returns the total time, in nanoseconds, that threads of the pool
+//        have spent running tasks
+// pre  : None
+// post : None, aside from description
+uint64_t WorkerPool::get_busy_time() {
+    return busy_time.load(std::memory_order_relaxed);
+}
+
+// desc : Returns the total time, in nanoseconds, that batches have taken,
+//        multiplied by the size of the pool
+// pre  : None
+// post : None, aside from description
+uint64_t WorkerPool::get_capacity_time() {
+    return capacity_time.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,105 @@
+#ifndef POOL
+#define POOL
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+///////////////////////////////////////////////////////////
+// A fixed set of long-lived threads that repeatedly work
+// through batches of numbered tasks. A batch acts as a
+// barrier: `run` only returns once every task in the batch
+// has completed, so one batch can be used per generation.
+///////////////////////////////////////////////////////////
+class WorkerPool {
+
+    // The background threads. The thread calling `run` also
+    // works on tasks, so there is one fewer of these than the
+    // size of the pool.
+    std::vector<std::thread> workers;
+
+    // Guards all of the batch bookkeeping below
+    std::mutex              mutex;
+    std::condition_variable start_cond;
+    std::condition_variable done_cond;
+
+    // The task of the current batch, and the number of times it
+    // must be called
+    std::function<void(size_t)> const *task;
+    size_t                      task_count;
+
+    // The index of the next task that has not been claimed
+    std::atomic<size_t> next_task;
+
+    // The number of background threads still working on the
+    // current batch
+    size_t   busy;
+    // Incremented whenever a new batch starts
+    uint64_t batch;
+    // Set when the pool is being destroyed
+    bool     stopping;
+
+    // The total time threads have spent working through batches, and
+    // the total time batches took times the size of the pool, both in
+    // nanoseconds. Their ratio is how busy the pool kept its threads.
+    std::atomic<uint64_t> busy_time;
+    std::atomic<uint64_t> capacity_time;
+
+    // desc : Claims and runs tasks of the current batch until none
+    //        remain, adding the time it took to `busy_time`
+    // pre  : A batch must be in progress
+    // post : None, aside from description
+    void drain();
+
+    // desc : The loop run by each background thread, waiting for
+    //        batches and working on them until the pool is destroyed
+    // pre  : None
+    // post : None, aside from description
+    void work();
+
+    public:
+
+    // desc : Starts a pool of the input size. A size of zero uses the
+    //        hardware concurrency of the machine.
+    // pre  : None
+    // post : None, aside from description
+    WorkerPool(size_t thread_count);
+
+    // desc : Stops and joins all background threads
+    // pre  : No batch may be in progress
+    // post : None, aside from description
+    ~WorkerPool();
+
+    // desc : Calls `task` once for each index in [0,count), spreading
+    //        the calls across the pool, and returns once all calls have
+    //        finished.
+    // pre  : Must not be called concurrently, or from within a task
+    // post : None, aside from description
+    void run(size_t count, std::function<void(size_t)> const& task);
+
+    // desc : Returns the number of threads that work on each batch,
+    //        including the caller of `run`
+    // pre  : None
+    // post : None, aside from description
+    size_t size();
+
+    // desc : Returns the total time, in nanoseconds, that threads of the
+    //        pool have spent running tasks
+    // pre  : None
+    // post : None, aside from description
+    uint64_t get_busy_time();
+
+    // desc : Returns the total time, in nanoseconds, that batches have
+    //        taken, multiplied by the size of the pool
+    // pre  : None
+    // post : None, aside from description
+    uint64_t get_capacity_time();
+};
+
+#endif //POOL
@@ -0,0 +1,68 @@
+#include <algorithm>
+#include "pyramid.h"
+
+// desc : Creates a pyramid for a `width` by `height` grid, adding levels
+//        of half the blocks across and down until one block is left
+// pre  : Width and height must not be negative
+// post : None, aside from description
+PopulationPyramid::PopulationPyramid(int64_t width, int64_t height) {
+    int64_t blocks_x = (width  + 63) / 64;
+    int64_t blocks_y = (height + 63) / 64;
+    levels.push_back(std::vector<uint64_t>(blocks_x * blocks_y, 0));
+    widths.push_back(blocks_x);
+    while ((blocks_x > 1) || (blocks_y > 1)) {
+        blocks_x = (blocks_x + 1) / 2;
+        blocks_y = (blocks_y + 1) / 2;
+        levels.push_back(std::vector<uint64_t>(blocks_x * blocks_y, 0));
+        widths.push_back(blocks_x);
+    }
+}
+
+// desc : Copies `blocks` into the bottom level, then sums each level
+//        into the one above it
+// pre  : `blocks` must hold a count for every block of the bottom level
+// post : None, aside from description
+void PopulationPyramid::assign(std::vector<uint64_t> const &blocks) {
+    levels[0] = blocks;
+    for (size_t level = 1; level < levels.size(); level++) {
+        std::vector<uint64_t> &below = levels[level - 1];
+        std::vector<uint64_t> &up    = levels[level];
+        int64_t below_x = widths[level - 1];
+        int64_t up_x    = widths[level];
+        std::fill(up.begin(), up.end(), 0);
+        for (size_t i = 0; i < below.size(); i++) {
+            int64_t bx = i % below_x;
+            int64_t by = i / below_x;
+            up[(by / 2) * up_x + bx / 2] += below[i];
+        }
+    }
+}
+
+// desc : Adds `delta` to the block and to the block covering it on every
+//        level above
+// pre  : The coordinates must be valid for the bottom level, and no
+//        count may drop below zero
+// post : None, aside from description
+void PopulationPyramid::add(int64_t bx, int64_t by, int64_t delta) {
+    for (size_t level = 0; level < levels.size(); level++) {
+        levels[level][(by >> level) * widths[level] + (bx >> level)] += delta;
+    }
+}
+
+// desc : Looks the square up on the level whose blocks are its size, or
+//        on the top level if it is larger than the grid
+// pre  : `scale` must be a power of two of at least 64, both coordinates
+//        must be multiples of it, and the corner must be inside the grid
+// post : None, aside from description
+uint64_t PopulationPyramid::count(int64_t x, int64_t y, int64_t scale) {
+    // Squares larger than the top block can only start at (0,0)
+    size_t level = std::min<size_t>(__builtin_ctzll(scale) - 6, levels.size() - 1);
+    return levels[level][(y >> (6 + level)) * widths[level] + (x >> (6 + level))];
+}
+
+// desc : Returns the count of the top block, which covers the whole grid
+// pre  : None
+// post : None, aside from description
+uint64_t PopulationPyramid::total() {
+    return levels.back().empty() ? 0 : levels.back()[0];
+}
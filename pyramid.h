@@ -0,0 +1,65 @@
+#ifndef PYRAMID
+#define PYRAMID
+
+#include <cstdint>
+#include <vector>
+
+///////////////////////////////////////////////////////////
+// Counts the live tiles of a bounded grid in aligned squares
+// of every power-of-two size from 64x64 up, for drawing
+// zoomed-out views.
+//
+// The bottom level counts the live tiles of every 64x64
+// block, and every other level sums 2x2 groups of the level
+// below, up to a single block covering the whole grid.
+// Engines add each block's population change as they commit
+// a step, so the pyramid costs nothing while the board is
+// quiet and a square of any size is counted with a single
+// lookup.
+///////////////////////////////////////////////////////////
+class PopulationPyramid {
+
+    // The levels, each stored row by row, and the number of blocks
+    // across each level. A block of level k covers 64<<k by 64<<k
+    // tiles.
+    std::vector<std::vector<uint64_t>> levels;
+    std::vector<int64_t>               widths;
+
+    public:
+
+    // desc : Creates a pyramid for a `width` by `height` grid with every
+    //        count at zero
+    // pre  : Width and height must not be negative
+    // post : None, aside from description
+    PopulationPyramid(int64_t width, int64_t height);
+
+    // desc : Sets the count of every 64x64 block from `blocks`, stored
+    //        row by row, and sums them up into every level above
+    // pre  : `blocks` must hold a count for every block of the bottom
+    //        level
+    // post : None, aside from description
+    void assign(std::vector<uint64_t> const &blocks);
+
+    // desc : Adds `delta` to the count of the 64x64 block at the input
+    //        block coordinates, and to every block above it
+    // pre  : The coordinates must be valid for the bottom level, and no
+    //        count may drop below zero
+    // post : None, aside from description
+    void add(int64_t bx, int64_t by, int64_t delta);
+
+    // desc : Returns the number of live tiles in the `scale` by `scale`
+    //        square whose top-left corner is at the input coordinates.
+    //        Squares larger than the grid are counted by the top block.
+    // pre  : `scale` must be a power of two of at least 64, both
+    //        coordinates must be multiples of it, and the corner must be
+    //        inside the grid
+    // post : None, aside from description
+    uint64_t count(int64_t x, int64_t y, int64_t scale);
+
+    // desc : Returns the number of live tiles in the whole grid
+    // pre  : None
+    // post : None, aside from description
+    uint64_t total();
+};
+
+#endif //PYRAMID
@@ -0,0 +1,488 @@
+#include <algorithm>
+#include <cstring>
+#include <csignal>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "strips.h"
+#include "kernel.h"
+
+// The capacity of the transports carrying commands and replies
+static const size_t control_capacity = 4096;
+
+// desc : Makes a shared memory ring buffer of the input capacity
+// pre  : None
+// post : Throws a std::runtime_error if the shared memory can't be mapped
+Transport *make_shm_ring(size_t capacity) {
+    return new ShmRing(capacity);
+}
+
+// desc : Returns `size` bytes of zeroed memory that stay shared with any
+//        processes forked afterwards
+// pre  : `size` must be positive
+// post : Throws a std::runtime_error if the memory can't be mapped
+static void *map_shared(size_t size) {
+    void *mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("can't map shared memory for a strip");
+    }
+    return mapping;
+}
+
+// desc : Splits the input grid into strips of equal height, but for a
+//        shorter last one, copies each into shared memory along with
+//        the transports around it, then forks a worker process per strip.
+//        A grid without any tiles is left with no strips at all.
+// pre  : `workers` must be positive. Threads other than the calling one
+//        aren't copied into the workers, so nothing the workers use may
+//        depend on them.
+// post : Throws a std::runtime_error if the shared memory or the worker
+//        processes can't be set up. Whatever was set up before anything
+//        is thrown, including workers already started, is released.
+StripEngine::StripEngine(Grid &grid, int workers, uint64_t generation, TransportFactory transports)
+    : visible(0)
+    , width(grid.get_width())
+    , height(grid.get_height())
+    , generation(generation)
+    , pyramid(grid.get_width(), grid.get_height())
+{
+    // An empty grid has no tiles to step, so it gets no strips, and no
+    // workers or shared memory
+    if ((width == 0) || (height == 0)) {
+        strip_rows = 1;
+        return;
+    }
+
+    workers    = std::clamp<int>(workers, 1, height);
+    strip_rows = (height + workers - 1) / workers;
+    int    count     = (height + strip_rows - 1) / strip_rows;
+    int    words     = grid.get_words();
+    size_t row_bytes = size_t(words) * sizeof(uint64_t);
+    std::vector<uint64_t> blocks(size_t(words) * ((height + 63) / 64), 0);
+
+    try {
+        // Reserving up front keeps a failed push_back from losing what was
+        // just made for it
+        strips.reserve(count);
+        downward.reserve(count);
+        upward.reserve(count);
+        for (int i = 0; i < count; i++) {
+            Strip strip = {};
+            strip.begin = i * strip_rows;
+            strip.rows  = std::min<int>(strip_rows, height - strip.begin);
+            strips.push_back(strip);
+
+            Strip &added = strips.back();
+            size_t grid_bytes = size_t(words + 2) * (added.rows + 2) * sizeof(uint64_t);
+            for (Grid *&half : added.grids) {
+                void *mapping = map_shared(grid_bytes);
+                try {
+                    half = new Grid(width, added.rows, mapping, grid_bytes, 0);
+                } catch (...) {
+                    munmap(mapping, grid_bytes);
+                    throw;
+                }
+            }
+            added.row_changed = (uint8_t *) map_shared(2 * added.rows);
+            added.block_rows  = (added.begin + added.rows - 1) / 64 - added.begin / 64 + 1;
+            added.block_counts = (uint64_t *) map_shared(2 * size_t(added.block_rows) * row_bytes);
+            added.commands    = transports(control_capacity);
+            added.replies     = transports(control_capacity);
+            for (int y = 0; y < added.rows; y++) {
+                std::memcpy(added.grids[0]->row(y), grid.row(added.begin + y), row_bytes);
+            }
+            added.population = added.grids[0]->population();
+            for (int y = 0; y < added.rows; y++) {
+                int       block = (added.begin + y) / 64;
+                uint64_t *row   = added.grids[0]->row(y);
+                for (int w = 0; w < words; w++) {
+                    added.hash ^= word_hash(uint64_t(added.begin + y) * words + w, row[w]);
+                    added.block_counts[(block - added.begin / 64) * words + w] += __builtin_popcountll(row[w]);
+                    blocks[size_t(block) * words + w] += __builtin_popcountll(row[w]);
+                }
+            }
+        }
+        pyramid.assign(blocks);
+
+        // Every edge row is read before the next one is sent, so room for
+        // two is plenty
+        for (int i = 0; i + 1 < count; i++) {
+            downward.push_back(transports(2 * row_bytes));
+            upward.push_back(transports(2 * row_bytes));
+        }
+
+        pid_t coordinator = getpid();
+        for (int i = 0; i < count; i++) {
+            pid_t pid = fork();
+            if (pid < 0) {
+                throw std::runtime_error("can't start a worker process");
+            }
+            if (pid == 0) {
+                // Workers die along with the coordinator rather than wait
+                // forever for its next command
+                prctl(PR_SET_PDEATHSIG, SIGKILL);
+                if (getppid() != coordinator) {
+                    _exit(1);
+                }
+                // Nothing thrown in a worker may reach the coordinator's
+                // cleanup below
+                try {
+                    work(i);
+                } catch (...) {
+                    _exit(1);
+                }
+                _exit(0);
+            }
+            strips[i].pid = pid;
+        }
+
+        // Only the coordinator's ends watch the workers, since the workers
+        // were forked without the watchdogs
+        for (Strip &strip : strips) {
+            strip.commands->set_watchdog([this] { check_workers(); });
+            strip.replies->set_watchdog([this] { check_workers(); });
+        }
+    } catch (...) {
+        release();
+        throw;
+    }
+}
+
+// desc : Stops the workers and frees the shared memory
+// pre  : None
+// post : None, aside from description
+StripEngine::~StripEngine() {
+    release();
+}
+
+// desc : Stops every worker that was started, waits for it to exit, and
+//        frees the shared memory and transports
+// pre  : None
+// post : None, aside from description
+void StripEngine::release() {
+    for (Strip &strip : strips) {
+        if (strip.pid > 0) {
+            Command command = {op_stop, 0, {}};
+            strip.commands->send(&command, sizeof(command));
+        }
+    }
+    for (Strip &strip : strips) {
+        if (strip.pid > 0) {
+            waitpid(strip.pid, nullptr, 0);
+        }
+        delete strip.grids[0];
+        delete strip.grids[1];
+        if (strip.row_changed != nullptr) {
+            munmap(strip.row_changed, 2 * strip.rows);
+        }
+        if (strip.block_counts != nullptr) {
+            munmap(strip.block_counts, 2 * size_t(strip.block_rows) * ((width + 63) / 64) * sizeof(uint64_t));
+        }
+        delete strip.commands;
+        delete strip.replies;
+    }
+    for (Transport *transport : downward) {
+        delete transport;
+    }
+    for (Transport *transport : upward) {
+        delete transport;
+    }
+    strips.clear();
+    downward.clear();
+    upward.clear();
+}
+
+// desc : Checks each worker for having exited without waiting on it,
+//        then kills and reaps all the rest if any has, since workers
+//        left waiting on one that exited never return. A pid of 0 marks
+//        a worker that was reaped.
+// pre  : None
+// post : Throws a std::runtime_error if any worker has exited or was
+//        stopped
+void StripEngine::check_workers() {
+    bool exited = false;
+    for (Strip &strip : strips) {
+        if ((strip.pid == 0) || (waitpid(strip.pid, nullptr, WNOHANG) == strip.pid)) {
+            strip.pid = 0;
+            exited    = true;
+        }
+    }
+    if (!exited) {
+        return;
+    }
+    for (Strip &strip : strips) {
+        if (strip.pid > 0) {
+            kill(strip.pid, SIGKILL);
+            waitpid(strip.pid, nullptr, 0);
+            strip.pid = 0;
+        }
+    }
+    throw std::runtime_error("a strip worker process exited");
+}
+
+// desc : Steps strip `index` each time the coordinator says to, until
+//        told to stop, first switching to the kernel each step names if
+//        it isn't the one in use. Before each step, the strip's edge rows
+//        are swapped with its neighbors' into the padding rows of the
+//        visible generation, which strips at the edges of the grid leave
+//        dead. Runs in the strip's worker process.
+// pre  : None
+// post : None, aside from description
+void StripEngine::work(int index) {
+    Strip     &strip    = strips[index];
+    bool       above    = (index > 0);
+    bool       below    = (index + 1 < (int) strips.size());
+    size_t     bytes    = size_t(width + 63) / 64 * sizeof(uint64_t);
+    int        current  = visible;
+    uint64_t   hash     = strip.hash;
+
+    while (true) {
+        Command command;
+        strip.commands->receive(&command, sizeof(command));
+        if (command.op == op_stop) {
+            return;
+        }
+        if (kernel_name() != command.kernel) {
+            set_kernel(command.kernel);
+        }
+
+        // Sending both rows before receiving either can't deadlock, since
+        // every transport has room for a row
+        Grid &prev = *strip.grids[current];
+        Grid &next = *strip.grids[current ^ 1];
+        if (above) {
+            upward[index - 1]->send(prev.row(0), bytes);
+        }
+        if (below) {
+            downward[index]->send(prev.row(strip.rows - 1), bytes);
+        }
+        if (above) {
+            downward[index - 1]->receive(prev.row(-1), bytes);
+        }
+        if (below) {
+            upward[index]->receive(prev.row(strip.rows), bytes);
+        }
+
+        Reply     reply  = {0, 0, hash};
+        uint8_t  *flags  = strip.row_changed + (current ^ 1) * strip.rows;
+        int       words  = prev.get_words();
+        uint64_t *counts = strip.block_counts + (current ^ 1) * size_t(strip.block_rows) * words;
+        std::fill(counts, counts + size_t(strip.block_rows) * words, 0);
+        for (int y = 0; y < strip.rows; y++) {
+            next.update_row(prev, y, command.rule);
+            uint64_t *after  = next.row(y);
+            uint64_t *before = prev.row(y);
+            uint64_t *block  = counts + ((strip.begin + y) / 64 - strip.begin / 64) * words;
+            uint64_t  diff   = 0;
+            for (int w = 0; w < words; w++) {
+                reply.population += __builtin_popcountll(after[w]);
+                block[w]         += __builtin_popcountll(after[w]);
+                if (after[w] != before[w]) {
+                    uint64_t at = uint64_t(strip.begin + y) * words + w;
+                    diff       += __builtin_popcountll(after[w] ^ before[w]);
+                    reply.hash ^= word_hash(at, before[w]) ^ word_hash(at, after[w]);
+                }
+            }
+            reply.changed += diff;
+            flags[y]       = (diff != 0);
+        }
+        current ^= 1;
+        hash     = reply.hash;
+        strip.replies->send(&reply, sizeof(reply));
+    }
+}
+
+// desc : Has every worker step its strip with the kernel this process
+//        uses, and waits until they all have, checking first that none
+//        has exited since the last step
+// pre  : Any step computed previously must have been committed
+// post : Throws a std::runtime_error if a worker has exited, after
+//        killing the others
+void StripEngine::step(int rule) {
+    check_workers();
+    Command command = {op_step, rule, {}};
+    kernel_name().copy(command.kernel, sizeof(command.kernel) - 1);
+    for (Strip &strip : strips) {
+        strip.commands->send(&command, sizeof(command));
+    }
+    for (Strip &strip : strips) {
+        Reply reply;
+        strip.replies->receive(&reply, sizeof(reply));
+        strip.next_population = reply.population;
+        strip.next_changed    = reply.changed;
+        strip.next_hash       = reply.hash;
+    }
+}
+
+// desc : Makes the generation the workers computed last visible, and
+//        adds the change in every block count of each strip that changed
+//        to the pyramid
+// pre  : `step` must have been called since the last commit
+// post : None, aside from description
+void StripEngine::commit() {
+    visible ^= 1;
+    size_t words = size_t(width + 63) / 64;
+    for (Strip &strip : strips) {
+        strip.population = strip.next_population;
+        strip.changed    = strip.next_changed;
+        strip.hash       = strip.next_hash;
+        if (strip.changed == 0) {
+            continue;
+        }
+        size_t    half   = size_t(strip.block_rows) * words;
+        uint64_t *after  = strip.block_counts + visible * half;
+        uint64_t *before = strip.block_counts + (visible ^ 1) * half;
+        for (size_t i = 0; i < half; i++) {
+            if (after[i] != before[i]) {
+                pyramid.add(i % words, strip.begin / 64 + i / words, int64_t(after[i]) - int64_t(before[i]));
+            }
+        }
+    }
+    generation++;
+}
+
+// desc : Returns whether or not the tile at the input coordinates is
+//        alive, read from the visible generation of the strip holding it,
+//        treating everything outside the grid as dead
+// pre  : None
+// post : None, aside from description
+bool StripEngine::get_tile(int64_t x, int64_t y) {
+    if ((x < 0) || (x >= width) || (y < 0) || (y >= height)) {
+        return false;
+    }
+    Strip &strip = strips[y / strip_rows];
+    return strip.grids[visible]->get_tile(x, y - strip.begin);
+}
+
+// desc : Returns the width of the grid
+// pre  : None
+// post : None, aside from description
+int64_t StripEngine::get_width() {
+    return width;
+}
+
+// desc : Returns the height of the grid
+// pre  : None
+// post : None, aside from description
+int64_t StripEngine::get_height() {
+    return height;
+}
+
+// desc : Returns the number of live tiles in the visible generation, as
+//        counted by the workers
+// pre  : None
+// post : None, aside from description
+uint64_t StripEngine::population() {
+    uint64_t total = 0;
+    for (Strip &strip : strips) {
+        total += strip.population;
+    }
+    return total;
+}
+
+// desc : Returns the number of committed generations
+// pre  : None
+// post : None, aside from description
+uint64_t StripEngine::get_generation() {
+    return generation;
+}
+
+// desc : Returns the engine's name, worker count, and kernel, which the
+//        workers switch to on their next step if it has changed
+// pre  : None
+// post : None, aside from description
+std::string StripEngine::describe() {
+    return "strips (" + std::to_string(strips.size()) + " worker processes, "
+         + kernel_name() + " kernel)";
+}
+
+// desc : Returns a copy of the visible generation, gathered a row at a
+//        time from the strips
+// pre  : The caller must keep `commit` from running concurrently
+// post : None, aside from description
+Grid *StripEngine::snapshot() {
+    Grid  *grid  = new Grid(width, height);
+    size_t bytes = size_t(grid->get_words()) * sizeof(uint64_t);
+    for (Strip &strip : strips) {
+        for (int y = 0; y < strip.rows; y++) {
+            std::memcpy(grid->row(strip.begin + y), strip.grids[visible]->row(y), bytes);
+        }
+    }
+    return grid;
+}
+
+// desc : Reports that the pattern never leaves the grid
+// pre  : None
+// post : None, aside from description
+bool StripEngine::stays_in_bounds() {
+    return true;
+}
+
+// desc : Returns the fraction of live tiles in the square, counting the
+//        tiles of squares narrower than a word from the rows of the
+//        strips holding them and looking larger squares up in the
+//        population pyramid
+// pre  : `scale` must be a power of two, and both coordinates must be
+//        multiples of it
+// post : None, aside from description
+double StripEngine::density(int64_t x, int64_t y, int64_t scale) {
+    if ((x < 0) || (x >= width) || (y < 0) || (y >= height)) {
+        return 0;
+    }
+    uint64_t count = 0;
+    if (scale < 64) {
+        uint64_t mask  = ((uint64_t(1) << scale) - 1) << (x & 63);
+        int64_t  y_end = std::min<int64_t>(y + scale, height);
+        for (int64_t row = y; row < y_end; row++) {
+            Strip &strip = strips[row / strip_rows];
+            count += __builtin_popcountll(strip.grids[visible]->row(row - strip.begin)[x >> 6] & mask);
+        }
+    } else {
+        count = pyramid.count(x, y, scale);
+    }
+    return double(count) / (double(scale) * double(scale));
+}
+
+// desc : Returns whether any row overlapping the rectangle changed in the
+//        last committed step, as flagged by the workers
+// pre  : None
+// post : None, aside from description
+bool StripEngine::area_changed(int64_t x, int64_t y, int64_t width, int64_t height) {
+    int64_t y_end = std::min<int64_t>(y + height, this->height);
+    if ((x >= this->width) || (x + width <= 0)) {
+        return false;
+    }
+    for (int64_t row = std::max<int64_t>(y, 0); row < y_end; row++) {
+        Strip &strip = strips[row / strip_rows];
+        if (strip.row_changed[visible * strip.rows + (row - strip.begin)]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// desc : Returns the number of tiles that changed in the last committed
+//        step, as counted by the workers
+// pre  : None
+// post : None, aside from description
+int64_t StripEngine::changed_tiles() {
+    int64_t total = 0;
+    for (Strip &strip : strips) {
+        total += strip.changed;
+    }
+    return total;
+}
+
+// desc : Returns the hash of the visible generation, combined from the
+//        hashes the workers keep of their strips
+// pre  : None
+// post : None, aside from description
+bool StripEngine::state_hash(uint64_t &hash) {
+    hash = 0;
+    for (Strip &strip : strips) {
+        hash ^= strip.hash;
+    }
+    return true;
+}
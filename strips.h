@@ -0,0 +1,183 @@
+#ifndef STRIPS
+#define STRIPS
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+#include "engine.h"
+#include "grid.h"
+#include "pyramid.h"
+#include "transport.h"
+
+// Makes a transport able to hold at least the input number of bytes
+using TransportFactory = std::function<Transport *(size_t capacity)>;
+
+// desc : Makes a shared memory ring buffer of the input capacity, the
+//        transport used unless another is asked for
+// pre  : None
+// post : Throws a std::runtime_error if the shared memory can't be mapped
+Transport *make_shm_ring(size_t capacity);
+
+///////////////////////////////////////////////////////////
+// Steps a bounded grid split into horizontal strips, each
+// owned and stepped by its own worker process, so that a
+// board can use more cores and memory bandwidth than one
+// process gets.
+//
+// Each generation, every worker sends its first row to the
+// worker above and its last row to the worker below, and
+// receives theirs into its padding rows, then steps its strip
+// on its own. Rows travel over transports, which are shared
+// memory ring buffers by default but can be anything a
+// TransportFactory makes, and commands and replies travel
+// between this coordinator and each worker the same way.
+//
+// While waiting on a worker, the coordinator checks every
+// tenth of a second that none of them has exited. If one has,
+// the rest are killed and the step throws, rather than
+// waiting forever on a worker that will never reply.
+//
+// Every strip keeps both of its generations in shared memory,
+// and the coordinator reads the visible one directly to
+// gather whatever part of the board is being viewed. Workers
+// only write the other generation, and `commit` just swaps
+// which one is visible, so stepping never disturbs readers.
+// Workers also keep the hash of their strip up to date from
+// the words that change, hashing words by their place in the
+// whole grid, so the strips' hashes combine into the hash a
+// grid engine would have. They count the live tiles of their
+// part of every 64x64 block too, and `commit` adds the
+// change in those counts to a population pyramid for
+// zoomed-out views.
+///////////////////////////////////////////////////////////
+class StripEngine : public Engine {
+
+    // The rows of the grid owned by one worker
+    struct Strip {
+        // The first row of the strip and the number of rows in it
+        int       begin;
+        int       rows;
+        // The strip's two generations, as grids whose buffers are in
+        // shared memory. The padding rows hold the neighboring strips'
+        // edge rows while stepping.
+        Grid     *grids[2];
+        // For each generation, one byte per row saying whether it
+        // changed in the step that produced it, in shared memory
+        uint8_t  *row_changed;
+        // For each generation, the live tiles the strip holds of every
+        // 64x64 block its rows overlap, in shared memory. Counts are
+        // stored row by row from the block row holding `begin`, and
+        // `block_rows` block rows are overlapped.
+        uint64_t *block_counts;
+        int       block_rows;
+        // Commands to the worker and its replies
+        Transport *commands;
+        Transport *replies;
+        // The worker's process, or 0 if it hasn't been started
+        pid_t     pid;
+        // The population of the strip, the tiles that changed, and the
+        // hash of the strip's words, for the visible generation and the
+        // one computed by the last step
+        uint64_t  population;
+        uint64_t  changed;
+        uint64_t  hash;
+        uint64_t  next_population;
+        uint64_t  next_changed;
+        uint64_t  next_hash;
+    };
+
+    // What a worker is told to do, and what it reports back after a step.
+    // Steps carry the name of the coordinator's kernel, since workers
+    // keep the kernel they were forked with unless told otherwise.
+    struct Command {
+        int  op;
+        int  rule;
+        char kernel[8];
+    };
+    struct Reply {
+        uint64_t population;
+        uint64_t changed;
+        uint64_t hash;
+    };
+    static const int op_step = 0;
+    static const int op_stop = 1;
+
+    std::vector<Strip>       strips;
+
+    // The transports carrying each strip's last row down to the strip
+    // below, and the next strip's first row up to it
+    std::vector<Transport *> downward;
+    std::vector<Transport *> upward;
+
+    // The number of rows in every strip but the last
+    int         strip_rows;
+
+    // Which of each strip's generations is visible
+    int         visible;
+
+    int64_t     width;
+    int64_t     height;
+    uint64_t    generation;
+
+    // The live tiles of every aligned square of the visible generation
+    PopulationPyramid pyramid;
+
+    // desc : Steps strip `index` each time the coordinator says to, until
+    //        told to stop. Runs in the strip's worker process.
+    // pre  : None
+    // post : None, aside from description
+    void work(int index);
+
+    // desc : Throws a std::runtime_error if any worker has exited or was
+    //        stopped, after killing and reaping all the others, which may
+    //        be stuck waiting on it
+    // pre  : None
+    // post : None, aside from description
+    void check_workers();
+
+    // desc : Stops every worker that was started, waits for it to exit,
+    //        and frees the shared memory and transports
+    // pre  : None
+    // post : None, aside from description
+    void release();
+
+    public:
+
+    // desc : Creates an engine evolving the input grid's pattern on a
+    //        bounded grid split into `workers` strips, starting a worker
+    //        process for each, and taking the grid to be generation
+    //        `generation` of the pattern. Transports are made by
+    //        `transports`. An empty grid starts no workers.
+    // pre  : `workers` must be positive. Threads other than the calling
+    //        one aren't copied into the workers, so nothing the workers
+    //        use may depend on them.
+    // post : Throws a std::runtime_error if the shared memory or the
+    //        worker processes can't be set up. Whatever was set up before
+    //        anything is thrown is released.
+    StripEngine(Grid &grid, int workers, uint64_t generation = 0,
+                TransportFactory transports = make_shm_ring);
+
+    // desc : Stops the workers and frees the shared memory
+    // pre  : None
+    // post : None, aside from description
+    ~StripEngine();
+
+    void        step(int rule) override;
+    void        commit() override;
+    bool        get_tile(int64_t x, int64_t y) override;
+    int64_t     get_width() override;
+    int64_t     get_height() override;
+    uint64_t    population() override;
+    uint64_t    get_generation() override;
+    std::string describe() override;
+    Grid       *snapshot() override;
+    bool        stays_in_bounds() override;
+    double      density(int64_t x, int64_t y, int64_t scale) override;
+    bool        area_changed(int64_t x, int64_t y, int64_t width, int64_t height) override;
+    int64_t     changed_tiles() override;
+    bool        state_hash(uint64_t &hash) override;
+};
+
+#endif //STRIPS
@@ -0,0 +1,288 @@
+#include <algorithm>
+#include "tiled.h"
+#include "kernel.h"
+
+// desc : Returns the block at the input block coordinates of `blocks`,
+//        or null if the coordinates are outside the grid
+// pre  : None
+// post : None, aside from description
+TiledEngine::Block *TiledEngine::block(std::vector<Block> &blocks, int bx, int by) {
+    if ((bx < 0) || (bx >= blocks_x) || (by < 0) || (by >= blocks_y)) {
+        return nullptr;
+    }
+    return &blocks[by * blocks_x + bx];
+}
+
+// desc : Copies the tiles bordering the input block of `prev` from its
+//        eight neighbors into its halo, using dead tiles past the edge
+//        of the grid
+// pre  : The coordinates must be valid for the grid of blocks
+// post : None, aside from description
+void TiledEngine::refresh_halo(int bx, int by) {
+    Block *center = block(prev, bx,   by  );
+    Block *n      = block(prev, bx,   by-1);
+    Block *s      = block(prev, bx,   by+1);
+    Block *w      = block(prev, bx-1, by  );
+    Block *e      = block(prev, bx+1, by  );
+    Block *nw     = block(prev, bx-1, by-1);
+    Block *ne     = block(prev, bx+1, by-1);
+    Block *sw     = block(prev, bx-1, by+1);
+    Block *se     = block(prev, bx+1, by+1);
+
+    // Only the neighbors' own rows are read, and only the halo of this
+    // block is written, so every block can be refreshed at once
+    center->rows[0]            = n ? n->rows[block_size] : 0;
+    center->rows[block_size+1] = s ? s->rows[1]          : 0;
+    for (int r=1; r<=block_size; r++) {
+        center->edges[r] = (w ? (w->rows[r] >> 63)       : 0)
+                         | (e ? ((e->rows[r] & 1) << 1)  : 0);
+    }
+    center->edges[0]            = (nw ? (nw->rows[block_size] >> 63)      : 0)
+                                | (ne ? ((ne->rows[block_size] & 1) << 1) : 0);
+    center->edges[block_size+1] = (sw ? (sw->rows[1] >> 63)               : 0)
+                                | (se ? ((se->rows[1] & 1) << 1)          : 0);
+}
+
+// desc : Computes the next state of the input block of `prev` into
+//        the matching block of `next`, unless neither it nor any of
+//        its neighbors changed in the last generation. `Rule` is the
+//        rule as a compile-time constant, or -1 to use `rule`.
+// pre  : The block's halo must be up to date
+// post : None, aside from description
+template<int Rule>
+void TiledEngine::step_block(int bx, int by, int rule, bool force) {
+    Block *src = block(prev, bx, by);
+    Block *dst = block(next, bx, by);
+
+    // A block whose whole neighborhood was stable is stable too, and
+    // `dst` is two generations old, so it already holds the right tiles
+    if (!force) {
+        bool active = false;
+        for (int dy=-1; dy<=1; dy++) {
+            for (int dx=-1; dx<=1; dx++) {
+                Block *neighbor = block(prev, bx+dx, by+dy);
+                active = active || (neighbor && neighbor->changed);
+            }
+        }
+        if (!active) {
+            dst->changed    = false;
+            dst->population = src->population;
+            return;
+        }
+    }
+
+    // Tiles past the edges of the grid must stay dead
+    int64_t  rows    = std::min<int64_t>(block_size, height - by * block_size);
+    int64_t  columns = width - bx * block_size;
+    uint64_t mask    = (columns >= 64) ? ~uint64_t(0) : (uint64_t(1) << columns) - 1;
+
+    bool     changed    = false;
+    uint64_t population = 0;
+    for (int r=1; r<=block_size; r++) {
+        uint64_t value = 0;
+        if (r <= rows) {
+            value = step_word<uint64_t>(
+                uint64_t(src->edges[r-1] & 1) << 63, src->rows[r-1], src->edges[r-1] >> 1,
+                uint64_t(src->edges[r  ] & 1) << 63, src->rows[r  ], src->edges[r  ] >> 1,
+                uint64_t(src->edges[r+1] & 1) << 63, src->rows[r+1], src->edges[r+1] >> 1,
+                (Rule < 0) ? rule : Rule
+            ) & mask;
+        }
+        changed     = changed || (value != src->rows[r]);
+        population += __builtin_popcountll(value);
+        dst->rows[r] = value;
+    }
+    dst->changed    = changed;
+    dst->population = population;
+}
+
+// desc : Creates an engine evolving the input grid's pattern, taking
+//        the grid to be generation `generation` of the pattern
+// pre  : None
+// post : None, aside from description
+TiledEngine::TiledEngine(Grid &grid, uint64_t generation)
+    : blocks_x((grid.get_width()  + block_size - 1) / block_size)
+    , blocks_y((grid.get_height() + block_size - 1) / block_size)
+    , prev(blocks_x * blocks_y, Block{})
+    , next(blocks_x * blocks_y, Block{})
+    , width(grid.get_width())
+    , height(grid.get_height())
+    , last_rule(-1)
+    , pyramid(grid.get_width(), grid.get_height())
+    , pool(0)
+    , generation(generation)
+{
+    // Each word of a grid row is exactly one row of a block
+    for (int y=0; y<height; y++) {
+        uint64_t *words = grid.row(y);
+        for (int bx=0; bx<blocks_x; bx++) {
+            Block *b = block(prev, bx, y / block_size);
+            b->rows[1 + y % block_size] = words[bx];
+            b->population += __builtin_popcountll(words[bx]);
+        }
+    }
+    std::vector<uint64_t> counts;
+    for (Block &b : prev) {
+        counts.push_back(b.population);
+    }
+    pyramid.assign(counts);
+}
+
+// desc : Refreshes every halo, then steps every block, each phase
+//        spread across the worker pool
+// pre  : Any step computed previously must have been committed
+// post : None, aside from description
+void TiledEngine::step(int rule) {
+    bool force = rule != last_rule;
+    last_rule  = rule;
+
+    size_t count = prev.size();
+    pool.run(count, [this](size_t index) {
+        refresh_halo(index % blocks_x, index / blocks_x);
+    });
+    with_rule(rule, [this, count, rule, force](auto fixed) {
+        pool.run(count, [this, rule, force](size_t index) {
+            step_block<decltype(fixed)::value>(index % blocks_x, index / blocks_x, rule, force);
+        });
+    });
+}
+
+// desc : Swaps the freshly computed generation into view, and adds the
+//        population change of every block that changed to the pyramid
+// pre  : `step` must have been called since the last commit
+// post : None, aside from description
+void TiledEngine::commit() {
+    std::swap(prev, next);
+    for (size_t i = 0; i < prev.size(); i++) {
+        if (prev[i].changed) {
+            int64_t delta = int64_t(prev[i].population) - int64_t(next[i].population);
+            if (delta != 0) {
+                pyramid.add(i % blocks_x, i / blocks_x, delta);
+            }
+        }
+    }
+    generation++;
+}
+
+// desc : Returns whether or not the tile at the input coordinates is
+//        alive, treating everything outside the grid as dead
+// pre  : None
+// post : None, aside from description
+bool TiledEngine::get_tile(int64_t x, int64_t y) {
+    if ((x < 0) || (x >= width) || (y < 0) || (y >= height)) {
+        return false;
+    }
+    Block *b = block(prev, x / block_size, y / block_size);
+    return (b->rows[1 + y % block_size] >> (x % block_size)) & 1;
+}
+
+// desc : Returns the width of the grid
+// pre  : None
+// post : None, aside from description
+int64_t TiledEngine::get_width() {
+    return width;
+}
+
+// desc : Returns the height of the grid
+// pre  : None
+// post : None, aside from description
+int64_t TiledEngine::get_height() {
+    return height;
+}
+
+// desc : Returns the number of live tiles in the visible generation, as
+//        counted by the top of the population pyramid
+// pre  : None
+// post : None, aside from description
+uint64_t TiledEngine::population() {
+    return pyramid.total();
+}
+
+// desc : Returns the number of committed generations
+// pre  : None
+// post : None, aside from description
+uint64_t TiledEngine::get_generation() {
+    return generation;
+}
+
+// desc : Returns the engine's name, block count, and thread count
+// pre  : None
+// post : None, aside from description
+std::string TiledEngine::describe() {
+    return "tiled (" + std::to_string(prev.size()) + " 64x64 blocks, "
+         + std::to_string(pool.size()) + " threads)";
+}
+
+// desc : Returns a copy of the visible generation, copying each block
+//        row into the matching word of the grid
+// pre  : The caller must keep `commit` from running concurrently
+// post : None, aside from description
+Grid *TiledEngine::snapshot() {
+    Grid *grid = new Grid(width, height);
+    for (int y=0; y<height; y++) {
+        uint64_t *words = grid->row(y);
+        for (int bx=0; bx<blocks_x; bx++) {
+            words[bx] = block(prev, bx, y / block_size)->rows[1 + y % block_size];
+        }
+    }
+    return grid;
+}
+
+// desc : Reports that the pattern never leaves the grid
+// pre  : None
+// post : None, aside from description
+bool TiledEngine::stays_in_bounds() {
+    return true;
+}
+
+// desc : Returns the fraction of live tiles in the square, counting the
+//        tiles of squares smaller than a block from its rows and looking
+//        larger squares up in the population pyramid
+// pre  : `scale` must be a power of two, and both coordinates must be
+//        multiples of it
+// post : None, aside from description
+double TiledEngine::density(int64_t x, int64_t y, int64_t scale) {
+    if ((x < 0) || (x >= width) || (y < 0) || (y >= height)) {
+        return 0;
+    }
+    uint64_t count = 0;
+    if (scale < block_size) {
+        Block   *b    = block(prev, x / block_size, y / block_size);
+        uint64_t mask = ((uint64_t(1) << scale) - 1) << (x % block_size);
+        for (int64_t r = y % block_size; r < y % block_size + scale; r++) {
+            count += __builtin_popcountll(b->rows[1 + r] & mask);
+        }
+    } else {
+        count = pyramid.count(x, y, scale);
+    }
+    return double(count) / (double(scale) * double(scale));
+}
+
+// desc : Returns whether any block overlapping the rectangle changed in
+//        the generation that produced it
+// pre  : None
+// post : None, aside from description
+bool TiledEngine::area_changed(int64_t x, int64_t y, int64_t width, int64_t height) {
+    int64_t x_end = std::min<int64_t>(x + width,  this->width);
+    int64_t y_end = std::min<int64_t>(y + height, this->height);
+    x = std::max<int64_t>(x, 0);
+    y = std::max<int64_t>(y, 0);
+    if ((x >= x_end) || (y >= y_end)) {
+        return false;
+    }
+    for (int64_t by = y / block_size; by <= (y_end - 1) / block_size; by++) {
+        for (int64_t bx = x / block_size; bx <= (x_end - 1) / block_size; bx++) {
+            if (block(prev, bx, by)->changed) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// desc : Returns the pool the engine steps with
+// pre  : None
+// post : None, aside from description
+WorkerPool *TiledEngine::get_pool() {
+    return &pool;
+}
@@ -0,0 +1,122 @@
+#ifndef TILED
+#define TILED
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "engine.h"
+#include "grid.h"
+#include "pool.h"
+#include "pyramid.h"
+
+///////////////////////////////////////////////////////////
+// Steps a bounded grid split into 64x64 blocks, each stored
+// contiguously along with a one-tile halo copied from its
+// neighbors. Stepping a block only touches the block itself,
+// so each task's working set is a few hundred bytes that stay
+// in L1 no matter how wide the board is.
+//
+// Each generation first refreshes every halo from the blocks
+// around it, then steps every block whose neighborhood
+// changed in the previous generation. Every block counts its
+// live tiles as it is stepped, and committing adds the
+// change of each block that changed to a population pyramid
+// for zoomed-out views.
+///////////////////////////////////////////////////////////
+class TiledEngine : public Engine {
+
+    public:
+
+    // The side length of a block, in tiles
+    static const int block_size = 64;
+
+    private:
+
+    // A 64x64 square of tiles and the ring of tiles around it
+    struct Block {
+        // Rows 1-64 hold the block's own tiles, bit i of a row being the
+        // tile at offset i. Rows 0 and 65 are the halo rows copied from
+        // the blocks above and below.
+        uint64_t rows[block_size + 2];
+        // For each entry of `rows`, bit 0 holds the halo tile to its left
+        // and bit 1 the halo tile to its right
+        uint8_t  edges[block_size + 2];
+        // Whether any of the block's own tiles changed in the generation
+        // that produced it
+        bool     changed;
+        // The number of the block's own tiles that are alive
+        uint64_t population;
+    };
+
+    // The number of blocks across and down the grid
+    int                blocks_x;
+    int                blocks_y;
+
+    // The visible generation, and the blocks the next one is computed
+    // into, each stored row by row
+    std::vector<Block> prev;
+    std::vector<Block> next;
+
+    // The dimensions of the grid, in tiles
+    int64_t            width;
+    int64_t            height;
+
+    // The rule used for the last step. Changing rules recomputes every
+    // block.
+    int                last_rule;
+
+    // The live tiles of every aligned square of the visible generation,
+    // whose bottom level is the population of each block
+    PopulationPyramid  pyramid;
+
+    // Threads reused for every generation
+    WorkerPool         pool;
+
+    uint64_t           generation;
+
+    // desc : Returns the block at the input block coordinates of `blocks`,
+    //        or null if the coordinates are outside the grid
+    // pre  : None
+    // post : None, aside from description
+    Block *block(std::vector<Block> &blocks, int bx, int by);
+
+    // desc : Copies the tiles bordering the input block of `prev` from its
+    //        eight neighbors into its halo, using dead tiles past the edge
+    //        of the grid
+    // pre  : The coordinates must be valid for the grid of blocks
+    // post : None, aside from description
+    void refresh_halo(int bx, int by);
+
+    // desc : Computes the next state of the input block of `prev` into
+    //        the matching block of `next`, unless neither it nor any of
+    //        its neighbors changed in the last generation. `Rule` is the
+    //        rule as a compile-time constant, or -1 to use `rule`.
+    // pre  : The block's halo must be up to date
+    // post : None, aside from description
+    template<int Rule>
+    void step_block(int bx, int by, int rule, bool force);
+
+    public:
+
+    // desc : Creates an engine evolving the input grid's pattern, taking
+    //        the grid to be generation `generation` of the pattern
+    // pre  : None
+    // post : None, aside from description
+    TiledEngine(Grid &grid, uint64_t generation = 0);
+
+    void        step(int rule) override;
+    void        commit() override;
+    bool        get_tile(int64_t x, int64_t y) override;
+    int64_t     get_width() override;
+    int64_t     get_height() override;
+    uint64_t    population() override;
+    uint64_t    get_generation() override;
+    std::string describe() override;
+    WorkerPool *get_pool() override;
+    Grid       *snapshot() override;
+    bool        stays_in_bounds() override;
+    double      density(int64_t x, int64_t y, int64_t scale) override;
+    bool        area_changed(int64_t x, int64_t y, int64_t width, int64_t height) override;
+};
+
+#endif //TILED
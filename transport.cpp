@@ -0,0 +1,124 @@
+#include <algorithm>
+#include <climits>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <linux/futex.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "transport.h"
+
+// desc : Frees any resources held by the transport
+// pre  : None
+// post : None, aside from description
+Transport::~Transport() {}
+
+// desc : Makes every wait for the other end call `check` every so often
+// pre  : None
+// post : None, aside from description
+void Transport::set_watchdog(std::function<void()> check) {
+    watchdog = check;
+}
+
+// How long a ring end with a watchdog sleeps before calling it
+static const timespec watch_interval = {0, 100 * 1000 * 1000};
+
+// desc : Sleeps until `word` is woken, unless it no longer holds
+//        `expected`, or until `timeout` passes if it isn't null, and
+//        returns whether the timeout passed. Uses a shared futex, so the
+//        waker may be another process mapping the same memory.
+// pre  : None
+// post : None, aside from description
+static bool futex_wait(std::atomic<uint32_t> *word, uint32_t expected, timespec const *timeout) {
+    long result = syscall(SYS_futex, (uint32_t *) word, FUTEX_WAIT, expected, timeout, nullptr, 0);
+    return (result == -1) && (errno == ETIMEDOUT);
+}
+
+// desc : Wakes every process sleeping on `word`
+// pre  : None
+// post : None, aside from description
+static void futex_wake(std::atomic<uint32_t> *word) {
+    syscall(SYS_futex, (uint32_t *) word, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+// desc : Creates a ring buffer holding at least `capacity` bytes, rounded
+//        up to a power of two so that positions wrap with a mask
+// pre  : Must be created before the processes using it are forked
+// post : Throws a std::runtime_error if the shared memory can't be mapped
+ShmRing::ShmRing(size_t capacity)
+    : capacity(1)
+{
+    while (this->capacity < capacity) {
+        this->capacity <<= 1;
+    }
+    mapping_size = sizeof(Header) + this->capacity;
+    mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("can't map shared memory for a ring buffer");
+    }
+    // Anonymous mappings start zeroed, which is an empty ring
+    header = (Header *) mapping;
+    buffer = (uint8_t *) mapping + sizeof(Header);
+}
+
+// desc : Unmaps this process's view of the ring buffer
+// pre  : None
+// post : None, aside from description
+ShmRing::~ShmRing() {
+    munmap(mapping, mapping_size);
+}
+
+// desc : Copies the input bytes into the ring as space frees up, waking
+//        the receiver after each contiguous piece, and calling the
+//        watchdog whenever a wait for space times out
+// pre  : Must only be called from the sending end
+// post : None, aside from description
+void ShmRing::send(void const *data, size_t size) {
+    uint8_t const *bytes = (uint8_t const *) data;
+    while (size > 0) {
+        uint32_t head = header->head.load(std::memory_order_relaxed);
+        uint32_t tail = header->tail.load(std::memory_order_acquire);
+        uint32_t free = capacity - (head - tail);
+        if (free == 0) {
+            if (futex_wait(&header->tail, tail, watchdog ? &watch_interval : nullptr)) {
+                watchdog();
+            }
+            continue;
+        }
+        uint32_t offset = head & (capacity - 1);
+        size_t   count  = std::min<size_t>({size, free, capacity - offset});
+        std::memcpy(buffer + offset, bytes, count);
+        header->head.store(head + count, std::memory_order_release);
+        futex_wake(&header->head);
+        bytes += count;
+        size  -= count;
+    }
+}
+
+// desc : Copies bytes out of the ring as they arrive until `size` have
+//        been received, waking the sender after each contiguous piece, and
+//        calling the watchdog whenever a wait for bytes times out
+// pre  : Must only be called from the receiving end
+// post : None, aside from description
+void ShmRing::receive(void *data, size_t size) {
+    uint8_t *bytes = (uint8_t *) data;
+    while (size > 0) {
+        uint32_t tail = header->tail.load(std::memory_order_relaxed);
+        uint32_t head = header->head.load(std::memory_order_acquire);
+        if (head == tail) {
+            if (futex_wait(&header->head, head, watchdog ? &watch_interval : nullptr)) {
+                watchdog();
+            }
+            continue;
+        }
+        uint32_t offset = tail & (capacity - 1);
+        size_t   count  = std::min<size_t>({size, head - tail, capacity - offset});
+        std::memcpy(bytes, buffer + offset, count);
+        header->tail.store(tail + count, std::memory_order_release);
+        futex_wake(&header->tail);
+        bytes += count;
+        size  -= count;
+    }
+}
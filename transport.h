@@ -0,0 +1,105 @@
+#ifndef TRANSPORT
+#define TRANSPORT
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+///////////////////////////////////////////////////////////
+// Carries bytes one way between two processes, in order.
+//
+// Both ends are created by one process, which then forks,
+// so a transport must keep working in both copies of itself
+// afterwards, as shared memory or a socket pair would. Each
+// end is used by a single thread of a single process.
+//
+// An end that waits on the other can be given a watchdog,
+// called every so often while it waits, which gives up on an
+// other end that has gone away by throwing.
+///////////////////////////////////////////////////////////
+class Transport {
+
+    protected:
+
+    // Called while waiting on the other end, if set
+    std::function<void()> watchdog;
+
+    public:
+
+    // desc : Makes every wait for the other end of this copy of the
+    //        transport call `check` every so often until it is over.
+    //        Anything `check` throws is thrown by the waiting call.
+    // pre  : None
+    // post : None, aside from description
+    void set_watchdog(std::function<void()> check);
+
+    // desc : Frees any resources held by the transport
+    // pre  : None
+    // post : None, aside from description
+    virtual ~Transport();
+
+    // desc : Sends the input bytes, waiting while the transport is too
+    //        full to take them
+    // pre  : Must only be called from the sending end
+    // post : None, aside from description
+    virtual void send(void const *data, size_t size) = 0;
+
+    // desc : Receives exactly `size` bytes into `data`, waiting until
+    //        they have all been sent
+    // pre  : Must only be called from the receiving end
+    // post : None, aside from description
+    virtual void receive(void *data, size_t size) = 0;
+};
+
+
+
+
+///////////////////////////////////////////////////////////
+// A transport between processes on the same machine, made of
+// a ring buffer in anonymous shared memory.
+//
+// The sender only ever advances `head` and the receiver only
+// ever advances `tail`, so neither needs a lock. An end that
+// has to wait sleeps on the other end's counter with a futex,
+// which, unlike std::atomic::wait, works across processes.
+// With a watchdog, a sleep that lasts a tenth of a second is
+// cut short to call it.
+///////////////////////////////////////////////////////////
+class ShmRing : public Transport {
+
+    // The counts of bytes ever written and read, which wrap around.
+    // Each sits on its own cache line so the two ends don't contend.
+    struct Header {
+        alignas(64) std::atomic<uint32_t> head;
+        alignas(64) std::atomic<uint32_t> tail;
+    };
+
+    // The shared mapping, holding the header followed by the buffer
+    void     *mapping;
+    size_t    mapping_size;
+
+    Header   *header;
+    uint8_t  *buffer;
+
+    // The size of the buffer in bytes, a power of two
+    uint32_t  capacity;
+
+    public:
+
+    // desc : Creates a ring buffer holding at least `capacity` bytes
+    // pre  : Must be created before the processes using it are forked
+    // post : Throws a std::runtime_error if the shared memory can't be
+    //        mapped
+    ShmRing(size_t capacity);
+
+    // desc : Unmaps this process's view of the ring buffer
+    // pre  : None
+    // post : None, aside from description
+    ~ShmRing();
+
+    void send(void const *data, size_t size) override;
+    void receive(void *data, size_t size) override;
+};
+
+#endif //TRANSPORT
@@ -1,3 +1,9 @@
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <locale.h>
+#include <sys/ioctl.h>
+#include <wchar.h>
 #include "tui.h"
 
 using namespace tui;
@@ -5,7 +11,7 @@ using namespace tui;
 // desc : Returns true if `other` represents an equivalent rgb
 // pre  : None
 // post : None, aside from desc
-bool RGB::operator==(RGB const& other) {
+bool RGB::operator==(RGB const& other) const {
     return    (other.red   == red  )
            && (other.green == green)
            && (other.blue  == blue );
@@ -14,7 +20,7 @@ bool RGB::operator==(RGB const& other) {
 // desc : Returns false if `other` represents an equivalent rgb
 // pre  : None
 // post : None, aside from desc
-bool RGB::operator!=(RGB const& other) {
+bool RGB::operator!=(RGB const& other) const {
     return  ! (*this == other);
 }
 
@@ -32,11 +38,21 @@ Tile::Tile()
 //        foreground and background color.
 // pre  : None
 // post : None, aside from desc
-Tile::Tile(std::string symbol, RGB fore, RGB back)
-    : symbol(symbol)
+Tile::Tile(std::string const &symbol, RGB fore, RGB back)
+    : Tile(symbol.c_str(), fore, back)
+{}
+
+// desc : Initializes tile as the provided NUL-terminated symbol with the
+//        given foreground and background color.
+// pre  : `symbol` must not be null
+// post : None, aside from desc
+Tile::Tile(char const *symbol, RGB fore, RGB back)
+    : symbol{}
     , fore_color(fore)
     , back_color(back)
-{}
+{
+    std::strncpy(this->symbol, symbol, symbol_capacity);
+}
 
 // desc : Initializes tile as a space character using the given 
 //        background color.
@@ -48,25 +64,130 @@ Tile::Tile(RGB color)
     , back_color(color)
 {}
 
+// desc : Returns true if `other` has the same symbol and colors
+// pre  : None
+// post : None, aside from desc
+bool Tile::operator==(Tile const& other) const {
+    return    (std::memcmp(symbol, other.symbol, sizeof(symbol)) == 0)
+           && (fore_color == other.fore_color)
+           && (back_color == other.back_color);
+}
+
+// desc : Returns false if `other` has the same symbol and colors
+// pre  : None
+// post : None, aside from desc
+bool Tile::operator!=(Tile const& other) const {
+    return  ! (*this == other);
+}
+
+// desc : Appends the decimal digits of the input value to `output`
+// pre  : None
+// post : None, aside from desc
+static void append_number(std::string &output, unsigned value) {
+    char digits[10];
+    int  count = 0;
+    do {
+        digits[count++] = '0' + (value % 10);
+        value /= 10;
+    } while (value != 0);
+    while (count > 0) {
+        output += digits[--count];
+    }
+}
+
+// desc : Appends an escape setting the foreground (`layer` 38) or
+//        background (`layer` 48) to the input color
+// pre  : None
+// post : None, aside from desc
+static void append_color(std::string &output, char const *layer, RGB color) {
+    output += "\033[";
+    output += layer;
+    output += ";2;";
+    append_number(output, color.red);
+    output += ';';
+    append_number(output, color.green);
+    output += ';';
+    append_number(output, color.blue);
+    output += 'm';
+}
+
+// The most bytes a tile adds to a frame: a move to its column of up to
+// 8 bytes, a foreground and a background color escape of up to 19 bytes
+// each, as in "\033[38;2;255;255;255m", and its symbol
+static const size_t max_tile_bytes = 8 + 2 * 19 + Tile::symbol_capacity;
+
+// The most bytes a row adds to a frame besides its tiles: moves to its
+// row and first column, the escapes back to the default colors, and a
+// line break
+static const size_t max_row_bytes = 16 + 10 + 2;
+
+// desc : Returns the number of bytes a full frame of a canvas of the
+//        input size can take up, so that building one never reallocates
+// pre  : None
+// post : None, aside from desc
+static size_t frame_capacity(size_t width, size_t height) {
+    return height*width*max_tile_bytes + height*max_row_bytes + 64;
+}
+
+// desc : Appends the tile's symbol to `output`, preceded by the escapes
+//        corresponding to its colors if `colors` is set
+// pre  : None
+// post : None, aside from desc
+void Tile::append_to(std::string &output, bool colors) const {
+    if (colors) {
+        // Spaces don't show their foreground color
+        if (std::strcmp(symbol, " ") != 0) {
+            append_color(output, "38", fore_color);
+        }
+        append_color(output, "48", back_color);
+    }
+    output += symbol;
+}
+
+// desc : Returns the number of terminal columns the tile's symbol takes
+//        up, decoding its first code point and asking wcwidth under a
+//        UTF-8 locale, or 0 if the width can't be told
+// pre  : None
+// post : None, aside from desc
+int Tile::columns() const {
+    unsigned char const *bytes = (unsigned char const *) symbol;
+    if (bytes[0] < 0x80) {
+        return ((bytes[0] >= 0x20) && (bytes[0] < 0x7F)) ? 1 : 0;
+    }
+    uint32_t code;
+    if (bytes[0] < 0xC0) {
+        // A stray continuation byte
+        return 0;
+    } else if (bytes[0] < 0xE0) {
+        code = ((bytes[0] & 0x1F) << 6)  | (bytes[1] & 0x3F);
+    } else if (bytes[0] < 0xF0) {
+        code = ((bytes[0] & 0x0F) << 12) | ((bytes[1] & 0x3F) << 6) | (bytes[2] & 0x3F);
+    } else {
+        code = ((bytes[0] & 0x07) << 18) | ((bytes[1] & 0x3F) << 12)
+             | ((bytes[2] & 0x3F) << 6)  | (bytes[3] & 0x3F);
+    }
+
+    // wcwidth only knows the widths of non-ASCII characters under a UTF-8
+    // locale, which is switched to for this thread alone so that the
+    // program's own locale is left alone
+    static locale_t utf8 = newlocale(LC_CTYPE_MASK, "C.UTF-8", (locale_t) 0);
+    if (utf8 == (locale_t) 0) {
+        return 0;
+    }
+    locale_t previous = uselocale(utf8);
+    int      width    = wcwidth(code);
+    uselocale(previous);
+    return std::max(width, 0);
+}
 
 // desc : Return's the tile's string content, preceded by the escapes
 //        corresponding to its colors
 // pre  : None
 // post : None, aside from desc
 Tile::operator std::string() {
-    std::stringstream ss;
-    if(symbol != " "){
-        ss << "\033[38;2;"
-           << (int) fore_color.red   << ";"
-           << (int) fore_color.green << ";"
-           << (int) fore_color.blue  << "m";
-    }
-    ss << "\033[48;2;"
-       << (int) back_color.red   << ";"
-       << (int) back_color.green << ";"
-       << (int) back_color.blue  << "m";
-    ss << symbol;
-    return ss.str();
+    std::string output;
+    append_to(output, true);
+    return output;
 }
 
 // desc : Simply returns the tile's string content
@@ -87,8 +208,14 @@ Canvas::Canvas(size_t width, size_t height, size_t x, size_t y)
     , offset_y(y)
     , prev_buffer(new Tile[height*width])
     , tile_buffer(new Tile[height*width])
+    , touched_rows(new bool[height]())
     , should_full_display(true)
-{}
+    , frame_bytes(0)
+    , total_bytes(0)
+    , frame_count(0)
+{
+    output.reserve(frame_capacity(width, height));
+}
 
 // desc/pre/post : Same as constructor above, but with zero offset
 Canvas::Canvas(size_t width, size_t height)
@@ -98,8 +225,14 @@ Canvas::Canvas(size_t width, size_t height)
     , offset_y(0)
     , prev_buffer(new Tile[height*width])
     , tile_buffer(new Tile[height*width])
+    , touched_rows(new bool[height]())
     , should_full_display(true)
-{}
+    , frame_bytes(0)
+    , total_bytes(0)
+    , frame_count(0)
+{
+    output.reserve(frame_capacity(width, height));
+}
 
 // desc : Frees the canvas's tile buffers
 // pre  : None
@@ -107,6 +240,7 @@ Canvas::Canvas(size_t width, size_t height)
 Canvas::~Canvas() {
     delete[] prev_buffer;
     delete[] tile_buffer;
+    delete[] touched_rows;
 }
 
 // desc : Resizes the canvas to the provided dimensions
@@ -118,7 +252,7 @@ void Canvas::resize(size_t width, size_t height) {
     Tile *new_prev_buffer = new Tile[height*width];
     // Establish bounds for copying tile data
     size_t x_limit = std::min(this->width,width);
-    size_t y_limit = std::min(this->width,width);
+    size_t y_limit = std::min(this->height,height);
     // Copy over tile data
     for (size_t y=0; y<y_limit; y++) {
         for (size_t x=0; x<x_limit; x++) {
@@ -129,12 +263,15 @@ void Canvas::resize(size_t width, size_t height) {
     // Free the original buffers
     delete[] tile_buffer;
     delete[] prev_buffer;
+    delete[] touched_rows;
     // Establish the new buffers in the corresponding members
     tile_buffer  = new_tile_buffer;
     prev_buffer  = new_prev_buffer;
+    touched_rows = new bool[height]();
     // Update the width and height members to match the inputs
     this->width  = width;
     this->height = height;
+    output.reserve(frame_capacity(width, height));
     should_full_display = true;
 }
 
@@ -163,33 +300,76 @@ Tile& Canvas::operator()(size_t x, size_t y) {
            << x << ',' << y << ')';
         throw std::runtime_error(ss.str());
     }
+    touched_rows[y] = true;
     return tile_buffer[y*width+x];
 }
 
+// desc : Appends an escape moving the cursor to the input column,
+//        counting from 1
+// pre  : None
+// post : None, aside from desc
+static void append_column(std::string &output, size_t column) {
+    output += "\033[";
+    append_number(output, column);
+    output += 'G';
+}
+
+// desc : Appends an escape moving the cursor down (for positive `delta`)
+//        or up (for negative `delta`) by the input number of rows
+// pre  : None
+// post : None, aside from desc
+static void append_rows(std::string &output, long delta) {
+    output += "\033[";
+    append_number(output, std::abs(delta));
+    output += (delta > 0) ? 'B' : 'A';
+}
+
+// desc : Writes out the frame built up in `output` with as few system
+//        calls as the terminal allows, usually one, and records its size
+// pre  : None
+// post : None, aside from description
+void Canvas::flush_output() {
+    // Anything still buffered by std::cout must come first
+    std::cout.flush();
+    char const *cursor    = output.data();
+    size_t      remaining = output.size();
+    while (remaining > 0) {
+        ssize_t count = write(STDOUT_FILENO, cursor, remaining);
+        if (count < 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            break;
+        }
+        cursor    += count;
+        remaining -= count;
+    }
+    frame_bytes  = output.size();
+    total_bytes += output.size();
+    frame_count++;
+}
+
 // desc : Hides the canvas's content by overwriting it with
 //        default-colored space character tiles
 // pre  : None
 // post : None, aside from description
 void Canvas::hide() {
-    std::string output;
+    output.clear();
     output += "\033[s";
     // Handle y offset
     if (offset_y != 0){
-        output += "\033[" + std::to_string(offset_y) + "B";
+        append_rows(output, offset_y);
     }
     // Switch to default colors
     output += "\033[39m\033[49m";
     for (size_t y=0; y<height; y++) {
         // Handle x offset
-        output += "\033[" + std::to_string(offset_x+1) + "G";
-        for (size_t x=0; x<width; x++) {
-            // Just write spaces everywhere
-            output += ' ';
-        }
+        append_column(output, offset_x+1);
+        output.append(width, ' ');
         output += "\r\n";
     }
     output += "\033[u";
-    std::cout << output;
+    flush_output();
     should_full_display = true;
 }
 
@@ -198,43 +378,51 @@ void Canvas::hide() {
 // pre  : None
 // post : None, aside from description
 void Canvas::full_display() {
-    std::string output;
+    output.clear();
     Tile *last_tile = nullptr;
     output += "\033[s";
     // Handle y offset
     if (offset_y != 0) {
-        output += "\033[" + std::to_string(offset_y) + "B";
+        append_rows(output, offset_y);
     }
-    bool mismatch;
-    for (int y=0; y<height; y++) {
-        mismatch = true;
-        for (int x=width-1; x>=0; x--) {
+    for (size_t y=0; y<height; y++) {
+        // Each row is written left to right from a single cursor move,
+        // since every tile of a known width leaves the cursor just past
+        // itself. Tiles after one of unknown width get a move of their own.
+        append_column(output, offset_x+1);
+        bool mismatch = true;
+        bool placed   = true;
+        for (size_t x=0; x<width; x++) {
             size_t index = y*width+x;
-            // Handle x offset
-            output += "\033[" + std::to_string(offset_x+x+1) + "G";
-
             Tile &current_tile = tile_buffer[index];
+            if (!placed) {
+                append_column(output, offset_x+x+1);
+            }
             if (last_tile != nullptr) {
                 mismatch |= last_tile->fore_color != current_tile.fore_color;
                 mismatch |= last_tile->back_color != current_tile.back_color;
             }
             last_tile = &current_tile;
             // Write out tile, avoiding escapes if they aren't necessary
-            if (mismatch) {
-                output += (std::string) current_tile;
-            } else {
-                output += current_tile.raw_symbol();
-            }
+            current_tile.append_to(output, mismatch);
             mismatch = false;
             // Record the state of the written tile
             prev_buffer[index] = current_tile;
+            // A double-width symbol covers the tile to its right
+            int columns = current_tile.columns();
+            placed = (columns > 0);
+            if ((columns == 2) && (x+1 < width)) {
+                x++;
+                prev_buffer[index+1] = tile_buffer[index+1];
+            }
         }
         // Escape to default colors when  moving to the next line
         output += "\033[39m\033[49m";
         output += "\r\n";
+        touched_rows[y] = false;
     }
     output += "\033[u";
-    std::cout << output;
+    flush_output();
     should_full_display = false;
 }
 
@@ -244,7 +432,7 @@ void Canvas::full_display() {
 // pre  : None, aside from description
 // post : None, aside from description
 void Canvas::lazy_display() {
-    std::string output;
+    output.clear();
     Tile *last_tile = nullptr;
 
     // Save cursor position
@@ -252,52 +440,52 @@ void Canvas::lazy_display() {
 
     // Handle y offset
     if (offset_y != 0) {
-        output += "\033[" + std::to_string(offset_y) + "B";
+        append_rows(output, offset_y);
     }
 
-    // Save position of the last tile we had to update
-    int last_y = 0;
-    int last_x = -1;
+    // Where the cursor is after the last tile we had to update, with
+    // cursor_x past the end of the row until its column is known
+    size_t cursor_y = 0;
+    size_t cursor_x = width + 1;
 
     bool first = true;
-    for (int y=0; y<height; y++) {
-        // Indicates the first tile in a row
-        for (int x=width-1; x>=0; x--) {
+    for (size_t y=0; y<height; y++) {
+        // Rows nobody accessed still match what was displayed
+        if (!touched_rows[y]) {
+            continue;
+        }
+        touched_rows[y] = false;
+        for (size_t x=0; x<width; x++) {
 
             // Get references to the previously displayed tile state for
             // this positon and the state that must now be displayed
-            int index = y*width+x;
-            Tile &prev_state = prev_buffer[y*width+x];
-            Tile &next_state = tile_buffer[y*width+x];
+            size_t index = y*width+x;
+            Tile &prev_state = prev_buffer[index];
+            Tile &next_state = tile_buffer[index];
 
             // Current tile needs to be updated if:
             //     - foreground color changes
             //     - background color changes
             //     - symbol changes
-            bool touched = (prev_state.fore_color != next_state.fore_color);
-            touched = touched || (prev_state.back_color != next_state.back_color);
-            touched = touched || (prev_state.symbol != next_state.symbol);
+            bool touched = (prev_state != next_state);
 
             // Only re-display a tile if it an update is required
             if (touched) {
 
-                // Adjust cursor x and y coordinates from last displayed tile
-                // position to the current position
-
-                // We move the cursor horizontally from right to left and by
-                // absolute positon to account for multi-column symbols (eg: emoji)
-                output += "\033[" + std::to_string(offset_x+x+1) + "G";
-
                 // We move the cursor from the top down and by relative position so that
                 // we can lock the canvas to a specific scroll position, meaning we don't
                 // destroy any of the terminal's previously printed lines.
-                if ( y != last_y ) {
-                    int delta = y - last_y;
-                    char trailer = (delta > 0) ? 'B' : 'A';
-                    output += "\033[" + std::to_string(std::abs(delta)) + trailer;
+                if (y != cursor_y) {
+                    append_rows(output, (long) y - (long) cursor_y);
+                    cursor_y = y;
+                    cursor_x = width + 1;
+                }
+
+                // Tiles are written left to right, so a tile right after the
+                // last one written needs no cursor movement at all
+                if (x != cursor_x) {
+                    append_column(output, offset_x+x+1);
                 }
-                last_x = x;
-                last_y = y;
 
                 // Whether or not the tile we are scanning through has colors
                 // matching the previous tile we actually updated
@@ -313,10 +501,17 @@ void Canvas::lazy_display() {
 
                 // If the colors don't match, add in the appropriate color escapes,
                 // otherwise just print the symbol
-                if(mismatch){
-                    output += (std::string) tile_buffer[y*width+x];
-                } else {
-                    output += tile_buffer[y*width+x].raw_symbol();
+                next_state.append_to(output, mismatch);
+
+                // After a symbol of unknown width, the next tile needs a
+                // cursor move whatever its column
+                int columns = next_state.columns();
+                cursor_x = (columns > 0) ? x + columns : width + 1;
+
+                // A double-width symbol covers the tile to its right
+                if ((columns == 2) && (x+1 < width)) {
+                    x++;
+                    prev_buffer[index+1] = tile_buffer[index+1];
                 }
 
                 // Remember the tile we most recently displayed
@@ -329,8 +524,16 @@ void Canvas::lazy_display() {
     output += "\033[u";
     // Set the foreground and background colors back to their defaults, just in case
     output += "\033[39m\033[49m";
-    std::cout << output;
-    std::cout.flush();
+    flush_output();
+}
+
+
+// desc : Makes the next `display` redraw every tile, for when something
+//        else has drawn over the canvas
+// pre  : None
+// post : None, aside from description
+void Canvas::refresh() {
+    should_full_display = true;
 }
 
 
@@ -348,6 +551,29 @@ void Canvas::display() {
     }
 }
 
+// desc : Returns the number of bytes written to the terminal by the last
+//        display or hide
+// pre  : None
+// post : None, aside from description
+size_t Canvas::get_frame_bytes() {
+    return frame_bytes;
+}
+
+// desc : Returns the number of bytes written to the terminal by every
+//        display and hide so far
+// pre  : None
+// post : None, aside from description
+uint64_t Canvas::get_total_bytes() {
+    return total_bytes;
+}
+
+// desc : Returns the number of displays and hides so far
+// pre  : None
+// post : None, aside from description
+uint64_t Canvas::get_frame_count() {
+    return frame_count;
+}
+
 // desc : Returns the canvas's width
 // pre  : None
 // post : None, aside from description
@@ -363,6 +589,22 @@ size_t Canvas::get_height() {
 }
 
 
+// desc : Stores the size of the terminal connected to stdout, in
+//        columns and rows, into `columns` and `rows`. Returns false and
+//        leaves both alone if stdout is not a terminal.
+// pre  : None
+// post : None, aside from description
+bool tui::terminal_size(size_t &columns, size_t &rows) {
+    winsize size;
+    if ((ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) != 0) || (size.ws_col == 0)) {
+        return false;
+    }
+    columns = size.ws_col;
+    rows    = size.ws_row;
+    return true;
+}
+
+
 
 // Raw mode logic adapted from the interesting tutorial at:
 // https://viewsourcecode.org/snaptoken/kilo/02.enteringRawMode.html
@@ -462,6 +704,21 @@ void TextBox::clear () {
     }
 }
 
+// desc : Overwrites every tile with a black space, including the last row
+//        and column, and moves the virtual cursor back to the top-left
+//        corner, so that the box can be written afresh
+// pre  : None
+// post : None, aside from description
+void TextBox::rewind () {
+    for (size_t y=0; y<height; y++) {
+        for (size_t x=0; x<width; x++) {
+            (*this)(x,y) = RGB{0,0,0};
+        }
+    }
+    cursor_x = 0;
+    cursor_y = 0;
+}
+
 // desc : Initializes the textbox to the provided dimensions
 //        at the provided absolute offset (relative to the
 //        base cursor position).
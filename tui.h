@@ -1,6 +1,7 @@
 #ifndef TUI
 #define TUI
 
+#include <cstdint>
 #include <iostream>
 #include <string>
 #include <sstream>
@@ -23,25 +24,31 @@ struct RGB{
     // desc : Returns true if `other` represents an equivalent rgb
     // pre  : None
     // post : None, aside from desc
-    bool operator ==(RGB const& other);
+    bool operator ==(RGB const& other) const;
     
     // desc : Returns false if `other` represents an equivalent rgb
     // pre  : None
     // post : None, aside from desc
-    bool operator !=(RGB const& other);
+    bool operator !=(RGB const& other) const;
 };
 
 
 
 
 // Represents a unicode symbol, foreground color, and
-// background color, for use in Canvases
+// background color, for use in Canvases.
+//
+// Tiles are plain, fixed-size values that never allocate, so
+// that canvas buffers can be filled and compared every frame
+// without touching the heap.
 struct Tile {
-    // This is a string, rather than a character, to support unicode
-    // rendering, since unicode characters are more than one char.
-    // We could get fancy with unicode representation/conversion, but
-    // a single string is sufficient for our purposes.
-    std::string symbol;
+    // The longest symbol a tile can hold, in bytes of UTF-8
+    static const size_t symbol_capacity = 7;
+
+    // The UTF-8 bytes of the symbol, padded with NUL bytes. This holds
+    // bytes rather than a single char to support unicode rendering,
+    // since unicode characters are more than one char.
+    char symbol[symbol_capacity + 1];
 
     // The foreground color of the tile, as in the color of the symbol
     // in the tile.
@@ -56,10 +63,18 @@ struct Tile {
     Tile();
     
     // desc : Initializes tile as the provided symbol with the given
-    //        foreground and background color.
+    //        foreground and background color. Symbols longer than
+    //        `symbol_capacity` bytes are cut short.
     // pre  : None
     // post : None, aside from desc
-    Tile(std::string symbol, RGB fore, RGB back);
+    Tile(std::string const &symbol, RGB fore, RGB back);
+
+    // desc : Same as the constructor above, but taking the symbol as a
+    //        NUL-terminated UTF-8 string, which avoids building a
+    //        std::string
+    // pre  : `symbol` must not be null
+    // post : None, aside from desc
+    Tile(char const *symbol, RGB fore, RGB back);
     
     // desc : Initializes tile as a space character using the given 
     //        background color.
@@ -67,6 +82,34 @@ struct Tile {
     // post : None, aside from desc
     Tile(RGB color);
 
+    // desc : Returns true if `other` has the same symbol and colors
+    // pre  : None
+    // post : None, aside from desc
+    bool operator ==(Tile const& other) const;
+
+    // desc : Returns false if `other` has the same symbol and colors
+    // pre  : None
+    // post : None, aside from desc
+    bool operator !=(Tile const& other) const;
+
+    // desc : Appends the tile's symbol to `output`, preceded by the
+    //        escapes corresponding to its colors if `colors` is set. The
+    //        escapes are written digit by digit, so nothing is allocated
+    //        once `output` has the capacity.
+    // pre  : None
+    // post : None, aside from desc
+    void append_to(std::string &output, bool colors) const;
+
+    // desc : Returns the number of terminal columns the tile's symbol
+    //        takes up, as reported by wcwidth: 2 for East Asian wide
+    //        characters and emoji, and 1 for most others. Returns 0 when
+    //        the width can't be told, such as for control characters or
+    //        where no UTF-8 locale is installed, so that callers don't
+    //        rely on where the cursor ends up.
+    // pre  : None
+    // post : None, aside from desc
+    int columns() const;
+
     // desc : Return's the tile's string content, preceded by the escapes
     //        corresponding to its colors
     // pre  : None
@@ -101,10 +144,31 @@ class Canvas {
     // time a display occurs
     Tile *tile_buffer;
 
+    // For each row, whether any of its tiles have been accessed through
+    // operator() since the last display. Rows that haven't can't have
+    // changed, so `lazy_display` skips them without comparing tiles.
+    bool *touched_rows;
+
     // Tracks whether or not the `display` function should perform a
     // `full_display` call
     bool should_full_display;
 
+    // The text of the frame being built, kept between frames so that
+    // its capacity is reused rather than reallocated
+    std::string output;
+
+    // The number of bytes written by the last display or hide, the
+    // total written so far, and the number of frames written
+    size_t   frame_bytes;
+    uint64_t total_bytes;
+    uint64_t frame_count;
+
+    // desc : Writes `output` to stdout, in a single system call unless
+    //        the terminal accepts less, and updates the byte counts
+    // pre  : None
+    // post : None, aside from description
+    void flush_output();
+
     public:
     
     // desc : Initializes the canvas to the provided dimensions at the
@@ -133,7 +197,8 @@ class Canvas {
     void reposition(size_t x, size_t y);
 
     // desc : Returns a reference to the tile at the provided offset
-    //        (relative to the top-left corner of the canvas)
+    //        (relative to the top-left corner of the canvas), and marks
+    //        its row to be compared by the next `lazy_display`
     // pre  : The provided offset must correspond to a valid tile
     //        in the canvas's current bounds
     // post : None, aside from description
@@ -151,11 +216,18 @@ class Canvas {
     void full_display();
 
     // desc : Updates a canvas's content, assuming it has previously been
-    //        fully displayed and that only changed tiles need to update
+    //        fully displayed and that only changed tiles need to update.
+    //        Only rows accessed since the last display are compared.
     // pre  : None, aside from description
     // post : None, aside from description
     void lazy_display();
     
+    // desc : Makes the next `display` redraw every tile, for when something
+    //        else has drawn over the canvas
+    // pre  : None
+    // post : None, aside from description
+    void refresh();
+
     // desc : Uses `full_display` to display the canvas if it hasn't been
     //        fully displayed since construction or the most recent resize.
     //        Otherwise, it uses `lazy_display` under the assumption that
@@ -164,6 +236,23 @@ class Canvas {
     // post : None, aside from description
     void display();
 
+    // desc : Returns the number of bytes written to the terminal by the
+    //        last display or hide
+    // pre  : None
+    // post : None, aside from description
+    size_t get_frame_bytes();
+
+    // desc : Returns the number of bytes written to the terminal by every
+    //        display and hide so far
+    // pre  : None
+    // post : None, aside from description
+    uint64_t get_total_bytes();
+
+    // desc : Returns the number of displays and hides so far
+    // pre  : None
+    // post : None, aside from description
+    uint64_t get_frame_count();
+
     // desc : Returns the canvas's width
     // pre  : None
     // post : None, aside from description
@@ -176,6 +265,14 @@ class Canvas {
 };
 
 
+// desc : Stores the size of the terminal connected to stdout, in
+//        columns and rows, into `columns` and `rows`. Returns false and
+//        leaves both alone if stdout is not a terminal.
+// pre  : None
+// post : None, aside from description
+bool terminal_size(size_t &columns, size_t &rows);
+
+
 
 
 // Used to configure the way the program recieves input
@@ -237,6 +334,13 @@ class TextBox : public Canvas {
     // post : None, aside from description
     void clear ();
 
+    // desc : Overwrites every tile with a black space, including the last
+    //        row and column, and moves the virtual cursor back to the
+    //        top-left corner, so that the box can be written afresh
+    // pre  : None
+    // post : None, aside from description
+    void rewind ();
+
     // desc : Initializes the textbox to the provided dimensions
     //        at the provided absolute offset (relative to the
     //        base cursor position).
@@ -269,7 +373,7 @@ class TextBox : public Canvas {
             } else if (c=='\t') {
                 cursor_x += 4;
             } else if ((c>=' ')&&(c<='~')) {
-                std::string str = {c,'\0'};
+                char str[2] = {c,'\0'};
                 (*this)(cursor_x,cursor_y) = Tile {
                     str,
                     {255,255,255},